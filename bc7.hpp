@@ -27,116 +27,30 @@
 #include <tuple>
 #include <algorithm>
 
+#include "bc7tables.hpp"
+
 namespace {
 
 using uint128_t = unsigned __int128;
 static_assert( alignof( uint128_t ) == 16 );
 
-constexpr inline uint8_t FIXUP_INDICES_2_SUBSETS[ 64 ] {
-    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
-    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
-    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
-    6,   2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
-};
-
-constexpr inline std::tuple<uint8_t, uint8_t> FIXUP_INDICES_3_SUBSETS[ 64 ] {
-    { 3, 15 }, { 3, 8 },   { 15, 8 }, { 15, 3 },  { 8, 15 }, { 3, 15 },  { 15, 3 },  { 15, 8 },
-    { 8, 15 }, { 8, 15 },  { 6, 15 }, { 6, 15 },  { 6, 15 }, { 5, 15 },  { 3, 15 },  { 3, 8 },
-    { 3, 15 }, { 3, 8 },   { 8, 15 }, { 15, 3 },  { 3, 15 }, { 3, 8 },   { 6, 15 },  { 10, 8 },
-    { 5, 3 },  { 8, 15 },  { 8, 6 },  { 6, 10 },  { 8, 15 }, { 5, 15 },  { 15, 10 }, { 15, 8 },
-    { 8, 15 }, { 15, 3 },  { 3, 15 }, { 5, 10 },  { 6, 10 }, { 10, 8 },  { 8, 9 },   { 15, 10 },
-    { 15, 6 }, { 3, 15 },  { 15, 8 }, { 5, 15 },  { 15, 3 }, { 15, 6 },  { 15, 6 },  { 15, 8 },
-    { 3, 15 }, { 15, 3 },  { 5, 15 }, { 5, 15 },  { 5, 15 }, { 8, 15 },  { 5, 15 },  { 10, 15 },
-    { 5, 15 }, { 10, 15 }, { 8, 15 }, { 13, 15 }, { 15, 3 }, { 12, 15 }, { 3, 15 },  { 3, 8 },
-};
-
-constexpr inline uint8_t BC7_PARTITION_2_SUBSETS[ 64 ][ 16 ] {
-    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 }, { 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1 },
-    { 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1 }, { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 1 },
-    { 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 },
-    { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 1 },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 },
-    { 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1 },
-    { 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 },
-    { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1 },
-    { 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1, 1 }, { 0, 1, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0 }, { 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0 },
-    { 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0 },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0 }, { 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 1 },
-    { 0, 0, 1, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0 }, { 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0 },
-    { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0 }, { 0, 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 0 },
-    { 0, 0, 0, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
-    { 0, 1, 1, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0 }, { 0, 0, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0 },
-    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 }, { 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1 },
-    { 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0 }, { 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0 },
-    { 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0 }, { 0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0 },
-    { 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1 }, { 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1 },
-    { 0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 0 }, { 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0, 0, 0 },
-    { 0, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0, 0 }, { 0, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 0 },
-    { 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0 }, { 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1 },
-    { 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1 }, { 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 0, 0, 0 },
-    { 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0 }, { 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0 }, { 0, 0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0 },
-    { 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 0, 1 },
-    { 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0 }, { 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0, 0, 0, 1, 1, 0 },
-    { 0, 1, 1, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 1 }, { 0, 1, 1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1 },
-    { 0, 1, 1, 1, 1, 1, 1, 0, 1, 0, 0, 0, 0, 0, 0, 1 }, { 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1 },
-    { 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0 },
-    { 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0 }, { 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1, 1, 1 },
-};
-
-constexpr inline uint8_t BC7_PARTITION_3_SUBSETS[ 64 ][ 16 ] {
-    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
-    { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
-    { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
-    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
-    { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 }, { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
-    { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
-    { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 }, { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
-    { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
-    { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
-    { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 }, { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
-    { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 }, { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
-    { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 }, { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
-    { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 }, { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
-    { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 }, { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
-    { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
-    { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 }, { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
-    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 }, { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
-    { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 }, { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
-    { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
-    { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 }, { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
-    { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 }, { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
-    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 }, { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
-    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 }, { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
-    { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 }, { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
-    { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 }, { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
-    { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
-    { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
-    { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
-    { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 }, { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
-    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 },
-};
-
 inline uint8_t lerp2bit( uint16_t e0, uint16_t e1, uint16_t index )
 {
-    static const uint16_t WEIGHTS[ 4 ]{ 0, 21, 43, 64 };
+    static constexpr uint16_t WEIGHTS[ 4 ]{ 0, 21, 43, 64 };
     const uint16_t w = WEIGHTS[ index ];
     return static_cast<uint8_t>( ( ( 64 - w ) * e0 + w * e1 + 32 ) >> 6 );
 }
 
 inline uint8_t lerp3bit( uint16_t e0, uint16_t e1, uint16_t indice )
 {
-    static const uint16_t WEIGHTS[ 8 ]{ 0, 9, 18, 27, 37, 46, 55, 64 };
+    static constexpr uint16_t WEIGHTS[ 8 ]{ 0, 9, 18, 27, 37, 46, 55, 64 };
     const uint16_t w = WEIGHTS[ indice ];
     return static_cast<uint8_t>( ( ( 64 - w ) * e0 + w * e1 + 32 ) >> 6 );
 }
 
 inline uint8_t lerp4bit( uint16_t e0, uint16_t e1, uint16_t indice )
 {
-    static const uint16_t WEIGHTS[ 16 ]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    static constexpr uint16_t WEIGHTS[ 16 ]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
     const uint16_t w = WEIGHTS[ indice ];
     return static_cast<uint8_t>( ( ( 64 - w ) * e0 + w * e1 + 32 ) >> 6 );
 }
@@ -170,6 +84,52 @@ constexpr inline uint8_t unpackComponent( uint8_t component, uint8_t pbit )
 }
 static_assert( unpackComponent<2,1,5>( 0b111100, 0 ) == 0b11110001 );
 
+template <size_t TBits>
+inline uint8_t lerpBits( uint16_t e0, uint16_t e1, uint16_t indice )
+{
+    if constexpr ( TBits == 2 ) return lerp2bit( e0, e1, indice );
+    else if constexpr ( TBits == 3 ) return lerp3bit( e0, e1, indice );
+    else return lerp4bit( e0, e1, indice );
+}
+
+struct Endpoint {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+// NOTE: every color a subset can take, interpolated once per block instead of once per texel
+template <size_t TBits>
+inline void subsetPalette( const Endpoint& e0, const Endpoint& e1, uint32_t* palette )
+{
+    for ( uint16_t i = 0; i < ( 1u << TBits ); ++i ) {
+        palette[ i ] = colorfn::makeARGB8888(
+            lerpBits<TBits>( e0.r, e1.r, i ),
+            lerpBits<TBits>( e0.g, e1.g, i ),
+            lerpBits<TBits>( e0.b, e1.b, i ),
+            lerpBits<TBits>( e0.a, e1.a, i ) );
+    }
+}
+
+// NOTE: palettes of all subsets laid out one after another, subset of a texel picks one of them
+template <size_t TBits>
+inline void paletteTile( const uint32_t* palette, const uint8_t* subsets, uint64_t indices, uint32_t* tile )
+{
+    for ( uint8_t i = 0; i < 16; ++i ) {
+        tile[ i ] = palette[ ( subsets[ i ] << TBits ) | readIndice<TBits>( indices, i ) ];
+    }
+}
+
+template <uint32_t TRotation>
+inline uint32_t rotatedARGB( uint8_t r, uint8_t g, uint8_t b, uint8_t a )
+{
+    if constexpr ( TRotation == 0b01 ) std::swap( a, r );
+    if constexpr ( TRotation == 0b10 ) std::swap( a, g );
+    if constexpr ( TRotation == 0b11 ) std::swap( a, b );
+    return colorfn::makeARGB8888( r, g, b, a );
+}
+
 struct alignas( 16 ) BC7 {
     struct Mode0 {
         uint128_t mode : 1;
@@ -185,12 +145,7 @@ struct alignas( 16 ) BC7 {
             assert( __builtin_popcount( mode ) == 1 );
             static constexpr auto& unpack = unpackComponent<4, 3, 1>;
             const uint8_t subset = BC7_PARTITION_3_SUBSETS[ partition ][ index ];
-            const auto [fixup1, fixup2] = FIXUP_INDICES_3_SUBSETS[ partition ];
-            uint64_t indices = bitsIndex;
-            indices = fixupIndices( indices, 2 );
-            indices = fixupIndices( indices, fixup1 * 3 + 2 );
-            indices = fixupIndices( indices, fixup2 * 3 + 2 );
-            uint8_t indice = readIndice<3>( indices, index );
+            uint8_t indice = readIndice<3>( indices(), index );
             switch ( subset ) {
             case 0: return colorfn::makeARGB8888(
                 lerp3bit( unpack( bitsR0, bitsP0 ), unpack( bitsR1, bitsP1 ), indice ),
@@ -213,6 +168,30 @@ struct alignas( 16 ) BC7 {
             [[unlikely]] default: return 0;
             }
         }
+
+        uint64_t indices() const
+        {
+            // NOTE: anchors not in ascending order in the table, lower one has to be expanded first
+            const auto [fixup1, fixup2] = std::minmax( std::get<0>( FIXUP_INDICES_3_SUBSETS[ partition ] ), std::get<1>( FIXUP_INDICES_3_SUBSETS[ partition ] ) );
+            uint64_t ret = bitsIndex;
+            ret = fixupIndices( ret, 2 );
+            ret = fixupIndices( ret, fixup1 * 3 + 2 );
+            ret = fixupIndices( ret, fixup2 * 3 + 2 );
+            return ret;
+        }
+
+        void decodeTile( uint32_t* tile ) const
+        {
+            static constexpr auto& unpack = unpackComponent<4, 3, 1>;
+            uint32_t palette[ 3 * 8 ];
+            subsetPalette<3>( { unpack( bitsR0, bitsP0 ), unpack( bitsG0, bitsP0 ), unpack( bitsB0, bitsP0 ), 255 },
+                { unpack( bitsR1, bitsP1 ), unpack( bitsG1, bitsP1 ), unpack( bitsB1, bitsP1 ), 255 }, palette );
+            subsetPalette<3>( { unpack( bitsR2, bitsP2 ), unpack( bitsG2, bitsP2 ), unpack( bitsB2, bitsP2 ), 255 },
+                { unpack( bitsR3, bitsP3 ), unpack( bitsG3, bitsP3 ), unpack( bitsB3, bitsP3 ), 255 }, palette + 8 );
+            subsetPalette<3>( { unpack( bitsR4, bitsP4 ), unpack( bitsG4, bitsP4 ), unpack( bitsB4, bitsP4 ), 255 },
+                { unpack( bitsR5, bitsP5 ), unpack( bitsG5, bitsP5 ), unpack( bitsB5, bitsP5 ), 255 }, palette + 16 );
+            paletteTile<3>( palette, BC7_PARTITION_3_SUBSETS[ partition ], indices(), tile );
+        }
     };
 
     struct Mode1 {
@@ -229,11 +208,7 @@ struct alignas( 16 ) BC7 {
             assert( __builtin_popcount( mode ) == 1 );
             static constexpr auto& unpack = unpackComponent<2, 1, 5>;
             const uint8_t subset = BC7_PARTITION_2_SUBSETS[ partition ][ index ];
-            const uint8_t fixup = FIXUP_INDICES_2_SUBSETS[ partition ];
-            uint64_t indices = bitsIndex;
-            indices = fixupIndices( indices, 2 );
-            indices = fixupIndices( indices, fixup * 3 + 2 );
-            uint8_t indice = readIndice<3>( indices, index );
+            uint8_t indice = readIndice<3>( indices(), index );
             switch ( subset ) {
             case 0: return colorfn::makeARGB8888(
                 lerp3bit( unpack( bitsR0, bitsP0 ), unpack( bitsR1, bitsP0 ), indice ),
@@ -250,6 +225,26 @@ struct alignas( 16 ) BC7 {
             [[unlikely]] default: return 0;
             }
         }
+
+        uint64_t indices() const
+        {
+            const uint8_t fixup = FIXUP_INDICES_2_SUBSETS[ partition ];
+            uint64_t ret = bitsIndex;
+            ret = fixupIndices( ret, 2 );
+            ret = fixupIndices( ret, fixup * 3 + 2 );
+            return ret;
+        }
+
+        void decodeTile( uint32_t* tile ) const
+        {
+            static constexpr auto& unpack = unpackComponent<2, 1, 5>;
+            uint32_t palette[ 2 * 8 ];
+            subsetPalette<3>( { unpack( bitsR0, bitsP0 ), unpack( bitsG0, bitsP0 ), unpack( bitsB0, bitsP0 ), 255 },
+                { unpack( bitsR1, bitsP0 ), unpack( bitsG1, bitsP0 ), unpack( bitsB1, bitsP0 ), 255 }, palette );
+            subsetPalette<3>( { unpack( bitsR2, bitsP1 ), unpack( bitsG2, bitsP1 ), unpack( bitsB2, bitsP1 ), 255 },
+                { unpack( bitsR3, bitsP1 ), unpack( bitsG3, bitsP1 ), unpack( bitsB3, bitsP1 ), 255 }, palette + 8 );
+            paletteTile<3>( palette, BC7_PARTITION_2_SUBSETS[ partition ], indices(), tile );
+        }
     };
 
     struct Mode2 {
@@ -265,12 +260,7 @@ struct alignas( 16 ) BC7 {
             assert( __builtin_popcount( mode ) == 1 );
             static constexpr auto& unpack = unpackComponent<3, 0, 2>;
             const uint8_t subset = BC7_PARTITION_3_SUBSETS[ partition ][ index ];
-            const auto [fixup1, fixup2] = FIXUP_INDICES_3_SUBSETS[ partition ];
-            uint64_t indices = bitsIndex;
-            indices = fixupIndices( indices, 1 );
-            indices = fixupIndices( indices, fixup1 * 2 + 1 );
-            indices = fixupIndices( indices, fixup2 * 2 + 1 );
-            uint8_t indice = readIndice<2>( indices, index );
+            uint8_t indice = readIndice<2>( indices(), index );
             switch ( subset ) {
             case 0: return colorfn::makeARGB8888(
                 lerp2bit( unpack( bitsR0, 0 ), unpack( bitsR1, 0 ), indice ),
@@ -293,6 +283,29 @@ struct alignas( 16 ) BC7 {
             [[unlikely]] default: return 0;
             }
         }
+
+        uint64_t indices() const
+        {
+            const auto [fixup1, fixup2] = std::minmax( std::get<0>( FIXUP_INDICES_3_SUBSETS[ partition ] ), std::get<1>( FIXUP_INDICES_3_SUBSETS[ partition ] ) );
+            uint64_t ret = bitsIndex;
+            ret = fixupIndices( ret, 1 );
+            ret = fixupIndices( ret, fixup1 * 2 + 1 );
+            ret = fixupIndices( ret, fixup2 * 2 + 1 );
+            return ret;
+        }
+
+        void decodeTile( uint32_t* tile ) const
+        {
+            static constexpr auto& unpack = unpackComponent<3, 0, 2>;
+            uint32_t palette[ 3 * 4 ];
+            subsetPalette<2>( { unpack( bitsR0, 0 ), unpack( bitsG0, 0 ), unpack( bitsB0, 0 ), 255 },
+                { unpack( bitsR1, 0 ), unpack( bitsG1, 0 ), unpack( bitsB1, 0 ), 255 }, palette );
+            subsetPalette<2>( { unpack( bitsR2, 0 ), unpack( bitsG2, 0 ), unpack( bitsB2, 0 ), 255 },
+                { unpack( bitsR3, 0 ), unpack( bitsG3, 0 ), unpack( bitsB3, 0 ), 255 }, palette + 4 );
+            subsetPalette<2>( { unpack( bitsR4, 0 ), unpack( bitsG4, 0 ), unpack( bitsB4, 0 ), 255 },
+                { unpack( bitsR5, 0 ), unpack( bitsG5, 0 ), unpack( bitsB5, 0 ), 255 }, palette + 8 );
+            paletteTile<2>( palette, BC7_PARTITION_3_SUBSETS[ partition ], indices(), tile );
+        }
     };
 
     struct Mode3 {
@@ -309,11 +322,7 @@ struct alignas( 16 ) BC7 {
             assert( __builtin_popcount( mode ) == 1 );
             static constexpr auto& unpack = unpackComponent<1, 0, 8>;
             const uint8_t subset = BC7_PARTITION_2_SUBSETS[ partition ][ index ];
-            const uint8_t fixup = FIXUP_INDICES_2_SUBSETS[ partition ];
-            uint64_t indices = bitsIndex;
-            indices = fixupIndices( indices, 1 );
-            indices = fixupIndices( indices, fixup * 2 + 1 );
-            uint8_t indice = readIndice<2>( indices, index );
+            uint8_t indice = readIndice<2>( indices(), index );
             switch ( subset ) {
             case 0: return colorfn::makeARGB8888(
                 lerp2bit( unpack( bitsR0, bitsP0 ), unpack( bitsR1, bitsP1 ), indice ),
@@ -330,6 +339,26 @@ struct alignas( 16 ) BC7 {
             [[unlikely]] default: return 0;
             }
         }
+
+        uint64_t indices() const
+        {
+            const uint8_t fixup = FIXUP_INDICES_2_SUBSETS[ partition ];
+            uint64_t ret = bitsIndex;
+            ret = fixupIndices( ret, 1 );
+            ret = fixupIndices( ret, fixup * 2 + 1 );
+            return ret;
+        }
+
+        void decodeTile( uint32_t* tile ) const
+        {
+            static constexpr auto& unpack = unpackComponent<1, 0, 8>;
+            uint32_t palette[ 2 * 4 ];
+            subsetPalette<2>( { unpack( bitsR0, bitsP0 ), unpack( bitsG0, bitsP0 ), unpack( bitsB0, bitsP0 ), 255 },
+                { unpack( bitsR1, bitsP1 ), unpack( bitsG1, bitsP1 ), unpack( bitsB1, bitsP1 ), 255 }, palette );
+            subsetPalette<2>( { unpack( bitsR2, bitsP2 ), unpack( bitsG2, bitsP2 ), unpack( bitsB2, bitsP2 ), 255 },
+                { unpack( bitsR3, bitsP3 ), unpack( bitsG3, bitsP3 ), unpack( bitsB3, bitsP3 ), 255 }, palette + 4 );
+            paletteTile<2>( palette, BC7_PARTITION_2_SUBSETS[ partition ], indices(), tile );
+        }
     };
 
     struct Mode4 {
@@ -379,6 +408,47 @@ struct alignas( 16 ) BC7 {
             }
             return colorfn::makeARGB8888( r, g, b, a );
         }
+
+        // NOTE: color and alpha palettes are disjoint channels once rotated, a texel ORs one entry of each
+        template <uint32_t TRotation, uint32_t TIdxMode>
+        void decodeTileAs( uint32_t* tile ) const
+        {
+            static constexpr auto& unpackC = unpackComponent<3, 0, 2>;
+            static constexpr auto& unpackA = unpackComponent<2, 0, 4>;
+            static constexpr size_t COLOR_BITS = TIdxMode ? 3 : 2;
+            static constexpr size_t ALPHA_BITS = TIdxMode ? 2 : 3;
+            const uint64_t indices1 = fixupIndices( bitsIndices1, 1 );
+            const uint64_t indices2 = fixupIndices( bitsIndices2, 2 );
+            const uint64_t colorIndices = TIdxMode ? indices2 : indices1;
+            const uint64_t alphaIndices = TIdxMode ? indices1 : indices2;
+            uint32_t colors[ 1 << COLOR_BITS ];
+            uint32_t alphas[ 1 << ALPHA_BITS ];
+            for ( uint16_t i = 0; i < ( 1u << COLOR_BITS ); ++i ) {
+                colors[ i ] = rotatedARGB<TRotation>(
+                    lerpBits<COLOR_BITS>( unpackC( bitsR0, 0 ), unpackC( bitsR1, 0 ), i ),
+                    lerpBits<COLOR_BITS>( unpackC( bitsG0, 0 ), unpackC( bitsG1, 0 ), i ),
+                    lerpBits<COLOR_BITS>( unpackC( bitsB0, 0 ), unpackC( bitsB1, 0 ), i ),
+                    0 );
+            }
+            for ( uint16_t i = 0; i < ( 1u << ALPHA_BITS ); ++i ) {
+                alphas[ i ] = rotatedARGB<TRotation>( 0, 0, 0, lerpBits<ALPHA_BITS>( unpackA( bitsA0, 0 ), unpackA( bitsA1, 0 ), i ) );
+            }
+            for ( uint8_t i = 0; i < 16; ++i ) {
+                tile[ i ] = colors[ readIndice<COLOR_BITS>( colorIndices, i ) ] | alphas[ readIndice<ALPHA_BITS>( alphaIndices, i ) ];
+            }
+        }
+
+        void decodeTile( uint32_t* tile ) const
+        {
+            using Kernel = void ( Mode4::* )( uint32_t* ) const;
+            static constexpr Kernel KERNELS[ 8 ]{
+                &Mode4::decodeTileAs<0b00, 0>, &Mode4::decodeTileAs<0b00, 1>,
+                &Mode4::decodeTileAs<0b01, 0>, &Mode4::decodeTileAs<0b01, 1>,
+                &Mode4::decodeTileAs<0b10, 0>, &Mode4::decodeTileAs<0b10, 1>,
+                &Mode4::decodeTileAs<0b11, 0>, &Mode4::decodeTileAs<0b11, 1>,
+            };
+            ( this->*KERNELS[ static_cast<uint32_t>( rotation ) << 1 | static_cast<uint32_t>( idxMode ) ] )( tile );
+        }
     };
 
     struct Mode5 {
@@ -391,6 +461,11 @@ struct alignas( 16 ) BC7 {
         uint128_t bitsColorIndex : 31;
         uint128_t bitsAlphaIndex : 31;
 
+        bool isUniform() const
+        {
+            return bitsR0 == bitsR1 && bitsG0 == bitsG1 && bitsB0 == bitsB1 && bitsA0 == bitsA1;
+        }
+
         uint32_t operator [] ( uint32_t index ) const
         {
             assert( __builtin_popcount( mode ) == 1 );
@@ -411,6 +486,36 @@ struct alignas( 16 ) BC7 {
             }
             return colorfn::makeARGB8888( r, g, b, a );
         }
+
+        template <uint32_t TRotation>
+        void decodeTileAs( uint32_t* tile ) const
+        {
+            static constexpr auto& unpack = unpackComponent<1, 0, 6>;
+            const uint64_t indicesC = fixupIndices( bitsColorIndex, 1 );
+            const uint64_t indicesA = fixupIndices( bitsAlphaIndex, 1 );
+            uint32_t colors[ 4 ];
+            uint32_t alphas[ 4 ];
+            for ( uint16_t i = 0; i < 4; ++i ) {
+                colors[ i ] = rotatedARGB<TRotation>(
+                    lerp2bit( unpack( bitsR0, 0 ), unpack( bitsR1, 0 ), i ),
+                    lerp2bit( unpack( bitsG0, 0 ), unpack( bitsG1, 0 ), i ),
+                    lerp2bit( unpack( bitsB0, 0 ), unpack( bitsB1, 0 ), i ),
+                    0 );
+                alphas[ i ] = rotatedARGB<TRotation>( 0, 0, 0, lerp2bit( bitsA0, bitsA1, i ) );
+            }
+            for ( uint8_t i = 0; i < 16; ++i ) {
+                tile[ i ] = colors[ readIndice<2>( indicesC, i ) ] | alphas[ readIndice<2>( indicesA, i ) ];
+            }
+        }
+
+        void decodeTile( uint32_t* tile ) const
+        {
+            using Kernel = void ( Mode5::* )( uint32_t* ) const;
+            static constexpr Kernel KERNELS[ 4 ]{
+                &Mode5::decodeTileAs<0b00>, &Mode5::decodeTileAs<0b01>, &Mode5::decodeTileAs<0b10>, &Mode5::decodeTileAs<0b11>,
+            };
+            ( this->*KERNELS[ static_cast<uint32_t>( rotation ) ] )( tile );
+        }
     };
 
     struct Mode6 {
@@ -422,6 +527,11 @@ struct alignas( 16 ) BC7 {
         uint128_t bitsP0 : 1; uint128_t bitsP1 : 1;
         uint128_t bitsIndex : 63;
 
+        bool isUniform() const
+        {
+            return bitsR0 == bitsR1 && bitsG0 == bitsG1 && bitsB0 == bitsB1 && bitsA0 == bitsA1 && bitsP0 == bitsP1;
+        }
+
         uint32_t operator [] ( uint32_t index ) const
         {
             assert( __builtin_popcount( mode ) == 1 );
@@ -434,6 +544,18 @@ struct alignas( 16 ) BC7 {
             uint8_t a = lerp4bit( unpack( bitsA0, bitsP0 ), unpack( bitsA1, bitsP1 ), indice );
             return colorfn::makeARGB8888( r, g, b, a );
         }
+
+        void decodeTile( uint32_t* tile ) const
+        {
+            static constexpr auto& unpack = unpackComponent<1, 0, 8>;
+            const uint64_t indices = fixupIndices( bitsIndex, 3 );
+            uint32_t palette[ 16 ];
+            subsetPalette<4>( { unpack( bitsR0, bitsP0 ), unpack( bitsG0, bitsP0 ), unpack( bitsB0, bitsP0 ), unpack( bitsA0, bitsP0 ) },
+                { unpack( bitsR1, bitsP1 ), unpack( bitsG1, bitsP1 ), unpack( bitsB1, bitsP1 ), unpack( bitsA1, bitsP1 ) }, palette );
+            for ( uint8_t i = 0; i < 16; ++i ) {
+                tile[ i ] = palette[ readIndice<4>( indices, i ) ];
+            }
+        }
     };
 
     struct Mode7 {
@@ -449,13 +571,9 @@ struct alignas( 16 ) BC7 {
         uint32_t operator [] ( uint32_t index ) const
         {
             assert( __builtin_popcount( mode ) == 1 );
-            static constexpr auto& unpack = unpackComponent<3, 1, 2>;
+            static constexpr auto& unpack = unpackComponent<3, 2, 3>;
             const uint8_t subset = BC7_PARTITION_2_SUBSETS[ partition ][ index ];
-            const uint8_t fixup = FIXUP_INDICES_2_SUBSETS[ partition ];
-            uint64_t indices = bitsIndex;
-            indices = fixupIndices( indices, 1 );
-            indices = fixupIndices( indices, fixup * 2 + 1 );
-            uint8_t indice = readIndice<2>( indices, index );
+            uint8_t indice = readIndice<2>( indices(), index );
             switch ( subset ) {
             case 0: return colorfn::makeARGB8888(
                 lerp2bit( unpack( bitsR0, bitsP0 ), unpack( bitsR1, bitsP1 ), indice ),
@@ -473,6 +591,26 @@ struct alignas( 16 ) BC7 {
             [[unlikely]] default: return 0;
             }
         }
+
+        uint64_t indices() const
+        {
+            const uint8_t fixup = FIXUP_INDICES_2_SUBSETS[ partition ];
+            uint64_t ret = bitsIndex;
+            ret = fixupIndices( ret, 1 );
+            ret = fixupIndices( ret, fixup * 2 + 1 );
+            return ret;
+        }
+
+        void decodeTile( uint32_t* tile ) const
+        {
+            static constexpr auto& unpack = unpackComponent<3, 2, 3>;
+            uint32_t palette[ 2 * 4 ];
+            subsetPalette<2>( { unpack( bitsR0, bitsP0 ), unpack( bitsG0, bitsP0 ), unpack( bitsB0, bitsP0 ), unpack( bitsA0, bitsP0 ) },
+                { unpack( bitsR1, bitsP1 ), unpack( bitsG1, bitsP1 ), unpack( bitsB1, bitsP1 ), unpack( bitsA1, bitsP1 ) }, palette );
+            subsetPalette<2>( { unpack( bitsR2, bitsP2 ), unpack( bitsG2, bitsP2 ), unpack( bitsB2, bitsP2 ), unpack( bitsA2, bitsP2 ) },
+                { unpack( bitsR3, bitsP3 ), unpack( bitsG3, bitsP3 ), unpack( bitsB3, bitsP3 ), unpack( bitsA3, bitsP3 ) }, palette + 4 );
+            paletteTile<2>( palette, BC7_PARTITION_2_SUBSETS[ partition ], indices(), tile );
+        }
     };
 
     union {
@@ -487,6 +625,19 @@ struct alignas( 16 ) BC7 {
         Mode7 mode7;
     };
 
+    static constexpr const char* NAME = "BC7";
+
+    // NOTE: only single subset modes with equal endpoints are checked, cheap enough to test per block
+    bool isUniform() const
+    {
+        const uint8_t mode = raw[ 0 ];
+        switch ( mode ? __builtin_ctz( mode ) : 8 ) {
+        case 5: return mode5.isUniform();
+        case 6: return mode6.isUniform();
+        default: return false;
+        }
+    }
+
     uint32_t operator [] ( uint32_t i ) const
     {
         const uint8_t mode = raw[ 0 ];
@@ -504,6 +655,26 @@ struct alignas( 16 ) BC7 {
             return colorfn::makeARGB8888( 0xD4, 0x21, 0x3D, 0xFF );
         }
     }
+
+    // NOTE: mode is dispatched once per block, its kernel decodes all 16 texels
+    void decodeTile( uint32_t* tile ) const
+    {
+        const uint8_t mode = raw[ 0 ];
+        switch ( mode ? __builtin_ctz( mode ) : 8 ) {
+        case 0: mode0.decodeTile( tile ); break;
+        case 1: mode1.decodeTile( tile ); break;
+        case 2: mode2.decodeTile( tile ); break;
+        case 3: mode3.decodeTile( tile ); break;
+        case 4: mode4.decodeTile( tile ); break;
+        case 5: mode5.decodeTile( tile ); break;
+        case 6: mode6.decodeTile( tile ); break;
+        case 7: mode7.decodeTile( tile ); break;
+        [[unlikely]] default:
+            assert( !"BC7 block corrupted, expected at least 1 bit set in mode field" );
+            std::fill_n( tile, 16, colorfn::makeARGB8888( 0xD4, 0x21, 0x3D, 0xFF ) );
+            break;
+        }
+    }
 };
 static_assert( sizeof( BC7 ) == 16, "sizeof BC7 not equal 16" );
 
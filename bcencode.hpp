@@ -0,0 +1,684 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Block compression encoders for generated test content.
+// Endpoints are fit along the principal axis of block texels, indices by nearest palette entry.
+// BC7 tries every mode and the most promising partitions and keeps the one with the least error,
+// same as production encoders do, so mode and partition distribution follows image content.
+// https://learn.microsoft.com/en-us/windows/win32/direct3d11/bc7-format-mode-reference
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "bc7tables.hpp"
+
+namespace {
+
+using Texel = std::array<uint8_t, 4>; // r, g, b, a
+
+namespace bcenc {
+
+constexpr inline uint8_t WEIGHTS_2BIT[ 4 ]{ 0, 21, 43, 64 };
+constexpr inline uint8_t WEIGHTS_3BIT[ 8 ]{ 0, 9, 18, 27, 37, 46, 55, 64 };
+constexpr inline uint8_t WEIGHTS_4BIT[ 16 ]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const uint8_t* weights( uint32_t indexBits )
+{
+    switch ( indexBits ) {
+    case 2: return WEIGHTS_2BIT;
+    case 3: return WEIGHTS_3BIT;
+    default: return WEIGHTS_4BIT;
+    }
+}
+
+static uint32_t interpolate( uint32_t e0, uint32_t e1, uint32_t weight )
+{
+    return ( ( 64 - weight ) * e0 + weight * e1 + 32 ) >> 6;
+}
+
+static uint32_t squared( int32_t v )
+{
+    return static_cast<uint32_t>( v * v );
+}
+
+static uint32_t distance( const Texel& lhs, const Texel& rhs, uint32_t first, uint32_t last )
+{
+    uint32_t ret = 0;
+    for ( uint32_t c = first; c < last; ++c ) {
+        ret += squared( (int32_t)lhs[ c ] - (int32_t)rhs[ c ] );
+    }
+    return ret;
+}
+
+// NOTE: scatter matrix of channels [first, last), sums not averages
+struct Scatter {
+    float mean[ 4 ]{};
+    float matrix[ 4 ][ 4 ]{};
+
+    Scatter( const Texel* texels, uint32_t count, uint32_t first, uint32_t last )
+    {
+        for ( uint32_t i = 0; i < count; ++i ) {
+            for ( uint32_t c = first; c < last; ++c ) mean[ c ] += texels[ i ][ c ];
+        }
+        for ( uint32_t c = first; c < last; ++c ) mean[ c ] /= static_cast<float>( count );
+        for ( uint32_t i = 0; i < count; ++i ) {
+            float d[ 4 ]{};
+            for ( uint32_t c = first; c < last; ++c ) d[ c ] = texels[ i ][ c ] - mean[ c ];
+            for ( uint32_t a = first; a < last; ++a ) {
+                for ( uint32_t b = first; b < last; ++b ) matrix[ a ][ b ] += d[ a ] * d[ b ];
+            }
+        }
+    }
+
+    // NOTE: power iteration, returns false when texels are all the same
+    bool principalAxis( uint32_t first, uint32_t last, uint32_t iterations, float ( &axis )[ 4 ] ) const
+    {
+        for ( uint32_t c = first; c < last; ++c ) axis[ c ] = 1.0f;
+        for ( uint32_t it = 0; it < iterations; ++it ) {
+            float next[ 4 ]{};
+            float length = 0.0f;
+            for ( uint32_t a = first; a < last; ++a ) {
+                for ( uint32_t b = first; b < last; ++b ) next[ a ] += matrix[ a ][ b ] * axis[ b ];
+                length = std::max( length, std::abs( next[ a ] ) );
+            }
+            if ( length <= 0.0f ) return false;
+            for ( uint32_t c = first; c < last; ++c ) axis[ c ] = next[ c ] / length;
+        }
+        float length = 0.0f;
+        for ( uint32_t c = first; c < last; ++c ) length += axis[ c ] * axis[ c ];
+        length = std::sqrt( length );
+        for ( uint32_t c = first; c < last; ++c ) axis[ c ] /= length;
+        return true;
+    }
+};
+
+// NOTE: squared error left after projecting texels on their principal axis, cheap partition ranking
+static float lineError( const Texel* texels, uint32_t count, uint32_t last )
+{
+    const Scatter scatter{ texels, count, 0, last };
+    float axis[ 4 ]{};
+    float trace = 0.0f;
+    for ( uint32_t c = 0; c < last; ++c ) trace += scatter.matrix[ c ][ c ];
+    if ( !scatter.principalAxis( 0, last, 4, axis ) ) return 0.0f;
+    float explained = 0.0f;
+    for ( uint32_t a = 0; a < last; ++a ) {
+        for ( uint32_t b = 0; b < last; ++b ) explained += axis[ a ] * scatter.matrix[ a ][ b ] * axis[ b ];
+    }
+    return std::max( trace - explained, 0.0f );
+}
+
+// NOTE: extremes of texels projected on principal axis of channels [first, last)
+static void fitEndpoints( const Texel* texels, uint32_t count, uint32_t first, uint32_t last, float ( &e0 )[ 4 ], float ( &e1 )[ 4 ] )
+{
+    const Scatter scatter{ texels, count, first, last };
+    float axis[ 4 ]{};
+    if ( !scatter.principalAxis( first, last, 8, axis ) ) {
+        for ( uint32_t c = first; c < last; ++c ) e0[ c ] = e1[ c ] = scatter.mean[ c ];
+        return;
+    }
+    float lo = 1e30f;
+    float hi = -1e30f;
+    for ( uint32_t i = 0; i < count; ++i ) {
+        float t = 0.0f;
+        for ( uint32_t c = first; c < last; ++c ) t += ( texels[ i ][ c ] - scatter.mean[ c ] ) * axis[ c ];
+        lo = std::min( lo, t );
+        hi = std::max( hi, t );
+    }
+    for ( uint32_t c = first; c < last; ++c ) {
+        e0[ c ] = std::clamp( scatter.mean[ c ] + axis[ c ] * lo, 0.0f, 255.0f );
+        e1[ c ] = std::clamp( scatter.mean[ c ] + axis[ c ] * hi, 0.0f, 255.0f );
+    }
+}
+
+class BitWriter {
+    uint8_t* m_data = nullptr;
+    uint32_t m_position = 0;
+
+public:
+    BitWriter( uint8_t* data )
+    : m_data{ data }
+    {}
+
+    void write( uint32_t value, uint32_t bits )
+    {
+        for ( uint32_t i = 0; i < bits; ++i, ++m_position ) {
+            if ( ( value >> i ) & 1u ) m_data[ m_position >> 3 ] |= static_cast<uint8_t>( 1u << ( m_position & 7 ) );
+        }
+    }
+};
+
+static uint16_t pack565( const float* c )
+{
+    const uint32_t r = static_cast<uint32_t>( std::lround( c[ 0 ] * 31.0f / 255.0f ) );
+    const uint32_t g = static_cast<uint32_t>( std::lround( c[ 1 ] * 63.0f / 255.0f ) );
+    const uint32_t b = static_cast<uint32_t>( std::lround( c[ 2 ] * 31.0f / 255.0f ) );
+    return static_cast<uint16_t>( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+// NOTE: palette is interpolated in 565 space, then expanded, same as the decoder does
+static Texel unpack565( uint16_t lhs, uint16_t rhs, uint32_t weight )
+{
+    const uint32_t r = interpolate( lhs >> 11, rhs >> 11, weight );
+    const uint32_t g = interpolate( ( lhs >> 5 ) & 0x3F, ( rhs >> 5 ) & 0x3F, weight );
+    const uint32_t b = interpolate( lhs & 0x1F, rhs & 0x1F, weight );
+    return Texel{
+        static_cast<uint8_t>( ( r << 3 ) | ( r >> 2 ) ),
+        static_cast<uint8_t>( ( g << 2 ) | ( g >> 4 ) ),
+        static_cast<uint8_t>( ( b << 3 ) | ( b >> 2 ) ),
+        255,
+    };
+}
+
+// NOTE: BC1 color block, also color half of BC2 and BC3.
+//       With punchThrough texels of alpha below 128 use 3 color mode transparent index.
+static void encodeColor( const Texel ( &block )[ 16 ], bool punchThrough, uint8_t* out )
+{
+    Texel opaque[ 16 ]{};
+    uint32_t count = 0;
+    for ( const Texel& t : block ) {
+        if ( !punchThrough || t[ 3 ] >= 128 ) opaque[ count++ ] = t;
+    }
+
+    uint16_t color0 = 0;
+    uint16_t color1 = 0;
+    if ( count ) {
+        float e0[ 4 ]{};
+        float e1[ 4 ]{};
+        fitEndpoints( opaque, count, 0, 3, e0, e1 );
+        color0 = pack565( e0 );
+        color1 = pack565( e1 );
+        const bool swap = punchThrough ? color0 > color1 : color0 < color1;
+        if ( swap ) std::swap( color0, color1 );
+    }
+
+    const bool fourColor = color0 > color1;
+    const Texel palette[ 4 ]{
+        unpack565( color0, color1, 0 ),
+        unpack565( color0, color1, 64 ),
+        unpack565( color0, color1, fourColor ? 21 : 32 ),
+        unpack565( color0, color1, 43 ),
+    };
+    const uint32_t entries = fourColor ? 4 : 3;
+    uint32_t indexes = 0;
+    for ( uint32_t i = 0; i < 16; ++i ) {
+        uint32_t index = 3;
+        if ( !punchThrough || block[ i ][ 3 ] >= 128 ) {
+            uint32_t best = ~0u;
+            for ( uint32_t p = 0; p < entries; ++p ) {
+                const uint32_t d = distance( block[ i ], palette[ p ], 0, 3 );
+                if ( d < best ) {
+                    best = d;
+                    index = p;
+                }
+            }
+        }
+        indexes |= index << ( i * 2 );
+    }
+    std::memcpy( out, &color0, 2 );
+    std::memcpy( out + 2, &color1, 2 );
+    std::memcpy( out + 4, &indexes, 4 );
+}
+
+static void encodeBC1( const Texel ( &block )[ 16 ], bool punchThrough, uint8_t* out )
+{
+    encodeColor( block, punchThrough, out );
+}
+
+static void encodeBC2( const Texel ( &block )[ 16 ], uint8_t* out )
+{
+    uint16_t alphas[ 4 ]{};
+    for ( uint32_t i = 0; i < 16; ++i ) {
+        const uint32_t a = ( block[ i ][ 3 ] * 15u + 127u ) / 255u;
+        alphas[ i / 4 ] |= static_cast<uint16_t>( a << ( ( i % 4 ) * 4 ) );
+    }
+    std::memcpy( out, alphas, sizeof( alphas ) );
+    encodeColor( block, false, out + 8 );
+}
+
+// NOTE: tries both interpolation modes, 8 values between extremes or 6 values plus exact 0 and 255
+static void encodeBC4( const uint8_t ( &values )[ 16 ], uint8_t* out )
+{
+    struct Candidate {
+        uint8_t e0;
+        uint8_t e1;
+        uint64_t indexes = 0;
+        uint32_t error = 0;
+    };
+    auto evaluate = []( const uint8_t ( &values )[ 16 ], uint8_t e0, uint8_t e1 ) {
+        static constexpr uint8_t WEIGHTS_8[ 8 ]{ 0, 64, 9, 18, 27, 37, 46, 55 };
+        static constexpr uint8_t WEIGHTS_6[ 6 ]{ 0, 64, 13, 26, 38, 51 };
+        uint32_t palette[ 8 ]{};
+        if ( e0 > e1 ) {
+            for ( uint32_t i = 0; i < 8; ++i ) palette[ i ] = interpolate( e0, e1, WEIGHTS_8[ i ] );
+        }
+        else {
+            for ( uint32_t i = 0; i < 6; ++i ) palette[ i ] = interpolate( e0, e1, WEIGHTS_6[ i ] );
+            palette[ 6 ] = 0;
+            palette[ 7 ] = 255;
+        }
+        Candidate ret{ e0, e1 };
+        for ( uint32_t i = 0; i < 16; ++i ) {
+            uint32_t best = ~0u;
+            uint64_t index = 0;
+            for ( uint32_t p = 0; p < 8; ++p ) {
+                const uint32_t d = squared( (int32_t)values[ i ] - (int32_t)palette[ p ] );
+                if ( d < best ) {
+                    best = d;
+                    index = p;
+                }
+            }
+            ret.indexes |= index << ( i * 3 );
+            ret.error += best;
+        }
+        return ret;
+    };
+
+    const auto [ lo, hi ] = std::minmax_element( std::begin( values ), std::end( values ) );
+    Candidate best = evaluate( values, *hi, *lo );
+    if ( best.error ) {
+        uint8_t innerLo = 255;
+        uint8_t innerHi = 0;
+        for ( uint8_t v : values ) {
+            if ( v == 0 || v == 255 ) continue;
+            innerLo = std::min( innerLo, v );
+            innerHi = std::max( innerHi, v );
+        }
+        if ( innerLo <= innerHi ) {
+            const Candidate other = evaluate( values, innerLo, innerHi );
+            if ( other.error < best.error ) best = other;
+        }
+    }
+    out[ 0 ] = best.e0;
+    out[ 1 ] = best.e1;
+    for ( uint32_t i = 0; i < 6; ++i ) {
+        out[ 2 + i ] = static_cast<uint8_t>( best.indexes >> ( i * 8 ) );
+    }
+}
+
+static void encodeBC4( const Texel ( &block )[ 16 ], uint32_t channel, uint8_t* out )
+{
+    uint8_t values[ 16 ]{};
+    for ( uint32_t i = 0; i < 16; ++i ) values[ i ] = block[ i ][ channel ];
+    encodeBC4( values, out );
+}
+
+static void encodeBC3( const Texel ( &block )[ 16 ], uint8_t* out )
+{
+    encodeBC4( block, 3, out );
+    encodeColor( block, false, out + 8 );
+}
+
+static void encodeBC5( const Texel ( &block )[ 16 ], uint8_t* out )
+{
+    encodeBC4( block, 0, out );
+    encodeBC4( block, 1, out + 8 );
+}
+
+struct BC7Mode {
+    uint8_t subsets;
+    uint8_t partitionBits;
+    uint8_t rotationBits;
+    uint8_t indexModeBits;
+    uint8_t colorBits;
+    uint8_t alphaBits;
+    uint8_t endpointPBits;
+    uint8_t sharedPBits;
+    uint8_t indexBits;
+    uint8_t indexBits2;
+};
+
+constexpr inline BC7Mode BC7_MODES[ 8 ]{
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+struct BC7Stats {
+    uint64_t modes[ 8 ]{};
+    uint64_t partitions[ 64 ]{}; // partitioned modes only
+};
+
+static const uint8_t* partitionTable( uint32_t subsets, uint32_t partition )
+{
+    static constexpr uint8_t SINGLE[ 16 ]{};
+    switch ( subsets ) {
+    case 2: return BC7_PARTITION_2_SUBSETS[ partition ];
+    case 3: return BC7_PARTITION_3_SUBSETS[ partition ];
+    default: return SINGLE;
+    }
+}
+
+static uint32_t anchorIndex( uint32_t subsets, uint32_t partition, uint32_t subset )
+{
+    if ( subset == 0 ) return 0;
+    if ( subsets == 2 ) return FIXUP_INDICES_2_SUBSETS[ partition ];
+    return subset == 1
+        ? std::get<0>( FIXUP_INDICES_3_SUBSETS[ partition ] )
+        : std::get<1>( FIXUP_INDICES_3_SUBSETS[ partition ] );
+}
+
+static uint32_t expandBits( uint32_t value, uint32_t bits )
+{
+    return bits >= 8 ? value : ( value << ( 8 - bits ) ) | ( value >> ( 2 * bits - 8 ) );
+}
+
+// NOTE: closest representable value at given precision, pbit of -1 means none
+static uint32_t quantize( float value, uint32_t bits, int pbit )
+{
+    const int max = ( 1 << bits ) - 1;
+    const int guess = static_cast<int>( std::lround( value * max / 255.0f ) );
+    uint32_t best = 0;
+    float bestError = 1e30f;
+    for ( int q = std::max( guess - 1, 0 ); q <= std::min( guess + 1, max ); ++q ) {
+        const uint32_t v = pbit < 0 ? expandBits( q, bits ) : expandBits( ( q << 1 ) | pbit, bits + 1 );
+        const float error = std::abs( v - value );
+        if ( error < bestError ) {
+            bestError = error;
+            best = static_cast<uint32_t>( q );
+        }
+    }
+    return best;
+}
+
+struct BC7Encoding {
+    uint32_t mode = 0;
+    uint32_t partition = 0;
+    uint32_t indexMode = 0;
+    uint8_t endpoints[ 3 ][ 2 ][ 4 ]{}; // quantized, without pbits
+    uint8_t pbits[ 3 ][ 2 ]{};
+    uint8_t colorIndices[ 16 ]{};
+    uint8_t alphaIndices[ 16 ]{}; // modes 4 and 5 only
+    uint64_t error = ~0ull;
+};
+
+class BC7Encoder {
+    const Texel ( &m_block )[ 16 ];
+
+    // NOTE: quantized endpoints of one subset and their decoded values
+    struct Quantized {
+        uint8_t q[ 2 ][ 4 ]{};
+        uint8_t p[ 2 ]{};
+        Texel value[ 2 ]{};
+        uint32_t error = 0;
+    };
+
+    static Quantized quantizeEndpoint( const BC7Mode& m, const float ( &e )[ 4 ], int pbit )
+    {
+        Quantized ret{};
+        const uint32_t channels = m.alphaBits ? 4 : 3;
+        ret.value[ 0 ][ 3 ] = 255;
+        for ( uint32_t c = 0; c < channels; ++c ) {
+            const uint32_t bits = c < 3 ? m.colorBits : m.alphaBits;
+            const uint32_t q = quantize( e[ c ], bits, pbit );
+            const uint32_t v = pbit < 0 ? expandBits( q, bits ) : expandBits( ( q << 1 ) | pbit, bits + 1 );
+            ret.q[ 0 ][ c ] = static_cast<uint8_t>( q );
+            ret.value[ 0 ][ c ] = static_cast<uint8_t>( v );
+            ret.error += squared( static_cast<int32_t>( v ) - static_cast<int32_t>( std::lround( e[ c ] ) ) );
+        }
+        ret.p[ 0 ] = static_cast<uint8_t>( std::max( pbit, 0 ) );
+        return ret;
+    }
+
+    static Quantized quantizeSubset( const BC7Mode& m, const float ( &e0 )[ 4 ], const float ( &e1 )[ 4 ] )
+    {
+        auto merge = []( const Quantized& lhs, const Quantized& rhs ) {
+            Quantized ret = lhs;
+            std::copy_n( rhs.q[ 0 ], 4, ret.q[ 1 ] );
+            ret.p[ 1 ] = rhs.p[ 0 ];
+            ret.value[ 1 ] = rhs.value[ 0 ];
+            ret.error += rhs.error;
+            return ret;
+        };
+        if ( m.endpointPBits ) {
+            auto pick = [&m]( const float ( &e )[ 4 ] ) {
+                const Quantized p0 = quantizeEndpoint( m, e, 0 );
+                const Quantized p1 = quantizeEndpoint( m, e, 1 );
+                return p0.error <= p1.error ? p0 : p1;
+            };
+            return merge( pick( e0 ), pick( e1 ) );
+        }
+        if ( m.sharedPBits ) {
+            const Quantized p0 = merge( quantizeEndpoint( m, e0, 0 ), quantizeEndpoint( m, e1, 0 ) );
+            const Quantized p1 = merge( quantizeEndpoint( m, e0, 1 ), quantizeEndpoint( m, e1, 1 ) );
+            return p0.error <= p1.error ? p0 : p1;
+        }
+        return merge( quantizeEndpoint( m, e0, -1 ), quantizeEndpoint( m, e1, -1 ) );
+    }
+
+    // NOTE: nearest palette entry for channels [first, last), returns error of chosen entries
+    static uint32_t pickIndices( const Texel* texels, const uint32_t* at, uint32_t count, const Texel& e0, const Texel& e1
+        , uint32_t first, uint32_t last, uint32_t indexBits, uint8_t* indices )
+    {
+        const uint8_t* w = weights( indexBits );
+        const uint32_t entries = 1u << indexBits;
+        Texel palette[ 16 ]{};
+        for ( uint32_t p = 0; p < entries; ++p ) {
+            for ( uint32_t c = first; c < last; ++c ) {
+                palette[ p ][ c ] = static_cast<uint8_t>( interpolate( e0[ c ], e1[ c ], w[ p ] ) );
+            }
+        }
+        uint32_t error = 0;
+        for ( uint32_t i = 0; i < count; ++i ) {
+            uint32_t best = ~0u;
+            for ( uint32_t p = 0; p < entries; ++p ) {
+                const uint32_t d = distance( texels[ i ], palette[ p ], first, last );
+                if ( d < best ) {
+                    best = d;
+                    indices[ at[ i ] ] = static_cast<uint8_t>( p );
+                }
+            }
+            error += best;
+        }
+        return error;
+    }
+
+public:
+    BC7Encoder( const Texel ( &block )[ 16 ] )
+    : m_block{ block }
+    {}
+
+    BC7Encoding encode( uint32_t mode, uint32_t partition, uint32_t indexMode ) const
+    {
+        const BC7Mode& m = BC7_MODES[ mode ];
+        const uint8_t* subsetOf = partitionTable( m.subsets, partition );
+        const bool separateAlpha = m.rotationBits;
+        const uint32_t colorChannels = m.alphaBits && !separateAlpha ? 4 : 3;
+        const uint32_t colorIndexBits = separateAlpha && indexMode ? m.indexBits2 : m.indexBits;
+        const uint32_t alphaIndexBits = indexMode ? m.indexBits : m.indexBits2;
+
+        BC7Encoding ret{};
+        ret.mode = mode;
+        ret.partition = partition;
+        ret.indexMode = indexMode;
+        ret.error = 0;
+        for ( uint32_t s = 0; s < m.subsets; ++s ) {
+            Texel texels[ 16 ]{};
+            uint32_t at[ 16 ]{};
+            uint32_t count = 0;
+            for ( uint32_t i = 0; i < 16; ++i ) {
+                if ( subsetOf[ i ] != s ) continue;
+                at[ count ] = i;
+                texels[ count++ ] = m_block[ i ];
+            }
+
+            float e0[ 4 ]{};
+            float e1[ 4 ]{};
+            fitEndpoints( texels, count, 0, colorChannels, e0, e1 );
+            if ( separateAlpha ) {
+                const auto [ lo, hi ] = std::minmax_element( texels, texels + count, []( const Texel& l, const Texel& r ) { return l[ 3 ] < r[ 3 ]; } );
+                e0[ 3 ] = ( *lo )[ 3 ];
+                e1[ 3 ] = ( *hi )[ 3 ];
+            }
+            Quantized qs = quantizeSubset( m, e0, e1 );
+            if ( !m.alphaBits ) {
+                qs.value[ 0 ][ 3 ] = qs.value[ 1 ][ 3 ] = 255;
+                for ( uint32_t i = 0; i < count; ++i ) ret.error += squared( 255 - texels[ i ][ 3 ] );
+            }
+
+            ret.error += pickIndices( texels, at, count, qs.value[ 0 ], qs.value[ 1 ], 0, colorChannels, colorIndexBits, ret.colorIndices );
+            const uint32_t anchor = anchorIndex( m.subsets, partition, s );
+            const uint32_t colorMax = ( 1u << colorIndexBits ) - 1;
+            if ( ret.colorIndices[ anchor ] > colorMax / 2 ) {
+                for ( uint32_t c = 0; c < colorChannels; ++c ) std::swap( qs.q[ 0 ][ c ], qs.q[ 1 ][ c ] );
+                std::swap( qs.p[ 0 ], qs.p[ 1 ] );
+                for ( uint32_t i = 0; i < count; ++i ) ret.colorIndices[ at[ i ] ] = static_cast<uint8_t>( colorMax - ret.colorIndices[ at[ i ] ] );
+            }
+            if ( separateAlpha ) {
+                ret.error += pickIndices( texels, at, count, qs.value[ 0 ], qs.value[ 1 ], 3, 4, alphaIndexBits, ret.alphaIndices );
+                const uint32_t alphaMax = ( 1u << alphaIndexBits ) - 1;
+                if ( ret.alphaIndices[ 0 ] > alphaMax / 2 ) {
+                    std::swap( qs.q[ 0 ][ 3 ], qs.q[ 1 ][ 3 ] );
+                    for ( uint8_t& i : ret.alphaIndices ) i = static_cast<uint8_t>( alphaMax - i );
+                }
+            }
+            std::copy_n( &qs.q[ 0 ][ 0 ], 8, &ret.endpoints[ s ][ 0 ][ 0 ] );
+            ret.pbits[ s ][ 0 ] = qs.p[ 0 ];
+            ret.pbits[ s ][ 1 ] = qs.p[ 1 ];
+        }
+        return ret;
+    }
+
+    static void pack( const BC7Encoding& enc, uint8_t* out )
+    {
+        const BC7Mode& m = BC7_MODES[ enc.mode ];
+        std::memset( out, 0, 16 );
+        BitWriter writer{ out };
+        writer.write( 1u << enc.mode, enc.mode + 1 );
+        writer.write( enc.partition, m.partitionBits );
+        writer.write( 0, m.rotationBits );
+        writer.write( enc.indexMode, m.indexModeBits );
+        for ( uint32_t c = 0; c < 3; ++c ) {
+            for ( uint32_t s = 0; s < m.subsets; ++s ) {
+                writer.write( enc.endpoints[ s ][ 0 ][ c ], m.colorBits );
+                writer.write( enc.endpoints[ s ][ 1 ][ c ], m.colorBits );
+            }
+        }
+        if ( m.alphaBits ) {
+            for ( uint32_t s = 0; s < m.subsets; ++s ) {
+                writer.write( enc.endpoints[ s ][ 0 ][ 3 ], m.alphaBits );
+                writer.write( enc.endpoints[ s ][ 1 ][ 3 ], m.alphaBits );
+            }
+        }
+        for ( uint32_t s = 0; s < m.subsets && m.endpointPBits; ++s ) {
+            writer.write( enc.pbits[ s ][ 0 ], 1 );
+            writer.write( enc.pbits[ s ][ 1 ], 1 );
+        }
+        for ( uint32_t s = 0; s < m.subsets && m.sharedPBits; ++s ) {
+            writer.write( enc.pbits[ s ][ 0 ], 1 );
+        }
+
+        const uint8_t* subsetOf = partitionTable( m.subsets, enc.partition );
+        const bool swapSets = m.rotationBits && enc.indexMode;
+        const uint8_t* primary = swapSets ? enc.alphaIndices : enc.colorIndices;
+        const uint8_t* secondary = swapSets ? enc.colorIndices : enc.alphaIndices;
+        for ( uint32_t i = 0; i < 16; ++i ) {
+            const bool anchor = anchorIndex( m.subsets, enc.partition, subsetOf[ i ] ) == i;
+            writer.write( primary[ i ], m.indexBits - anchor );
+        }
+        for ( uint32_t i = 0; i < 16 && m.indexBits2; ++i ) {
+            writer.write( secondary[ i ], m.indexBits2 - ( i == 0 ) );
+        }
+    }
+};
+
+// NOTE: partitions ranked by how well each subset fits a line, only the best few are encoded
+template <size_t TCount>
+static std::array<uint32_t, TCount> rankPartitions( const Texel ( &block )[ 16 ], uint32_t subsets, uint32_t partitions, uint32_t channels )
+{
+    std::array<float, 64> errors{};
+    for ( uint32_t p = 0; p < partitions; ++p ) {
+        const uint8_t* subsetOf = partitionTable( subsets, p );
+        for ( uint32_t s = 0; s < subsets; ++s ) {
+            Texel texels[ 16 ]{};
+            uint32_t count = 0;
+            for ( uint32_t i = 0; i < 16; ++i ) {
+                if ( subsetOf[ i ] == s ) texels[ count++ ] = block[ i ];
+            }
+            errors[ p ] += lineError( texels, count, channels );
+        }
+    }
+    std::array<uint32_t, 64> order{};
+    for ( uint32_t p = 0; p < 64; ++p ) order[ p ] = p;
+    std::partial_sort( order.begin(), order.begin() + TCount, order.begin() + partitions
+        , [&errors]( uint32_t l, uint32_t r ) { return errors[ l ] < errors[ r ]; } );
+    std::array<uint32_t, TCount> ret{};
+    std::copy_n( order.begin(), TCount, ret.begin() );
+    return ret;
+}
+
+static void encodeBC7( const Texel ( &block )[ 16 ], uint8_t* out, BC7Stats* stats = nullptr )
+{
+    static constexpr size_t PARTITION_CANDIDATES = 2;
+    const bool solid = std::all_of( std::begin( block ), std::end( block ), [&block]( const Texel& t ) { return t == block[ 0 ]; } );
+    const bool opaque = std::all_of( std::begin( block ), std::end( block ), []( const Texel& t ) { return t[ 3 ] == 255; } );
+
+    const BC7Encoder encoder{ block };
+    BC7Encoding best{};
+    auto consider = [&encoder, &best]( uint32_t mode, uint32_t partition, uint32_t indexMode ) {
+        const BC7Encoding candidate = encoder.encode( mode, partition, indexMode );
+        if ( candidate.error < best.error ) best = candidate;
+    };
+
+    if ( solid ) {
+        consider( 5, 0, 0 );
+        consider( 6, 0, 0 );
+    }
+    else {
+        const uint32_t channels = opaque ? 3 : 4;
+        const auto two = rankPartitions<PARTITION_CANDIDATES>( block, 2, 64, channels );
+        if ( opaque ) {
+            const auto three = rankPartitions<PARTITION_CANDIDATES>( block, 3, 64, channels );
+            const auto threeLow = rankPartitions<PARTITION_CANDIDATES>( block, 3, 16, channels );
+            for ( uint32_t p : threeLow ) consider( 0, p, 0 );
+            for ( uint32_t p : two ) consider( 1, p, 0 );
+            for ( uint32_t p : three ) consider( 2, p, 0 );
+            for ( uint32_t p : two ) consider( 3, p, 0 );
+        }
+        consider( 4, 0, 0 );
+        consider( 4, 0, 1 );
+        consider( 5, 0, 0 );
+        consider( 6, 0, 0 );
+        if ( !opaque ) {
+            for ( uint32_t p : two ) consider( 7, p, 0 );
+        }
+    }
+
+    BC7Encoder::pack( best, out );
+    if ( stats ) {
+        stats->modes[ best.mode ]++;
+        if ( BC7_MODES[ best.mode ].partitionBits ) stats->partitions[ best.partition ]++;
+    }
+}
+
+} // namespace bcenc
+
+} // namespace
@@ -0,0 +1,243 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// NOTE: page aligned anonymous mappings reused across create() calls,
+//       given back to the system when over the high-water cap or after being idle for a while.
+//       Shared by concurrent create() calls, m_mutex only guards the free list, mmap and munmap run outside it
+class BufferPool {
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2u << 20;
+    static constexpr size_t MAX_FREE_MAPPINGS = 16;
+    static constexpr std::chrono::seconds IDLE_TIMEOUT{ 30 };
+
+private:
+    struct Mapping {
+        void* data = nullptr;
+        size_t capacity = 0;
+    };
+
+    std::mutex m_mutex{};
+    std::condition_variable m_idle{};
+    std::vector<Mapping> m_free{};
+    std::chrono::steady_clock::time_point m_lastUse{};
+    size_t m_freeBytes = 0;
+    const size_t m_highWater = 0;
+    const size_t m_pageSize = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+    bool m_quit = false;
+    std::thread m_trimThread{};
+
+    size_t roundCapacity( size_t bytes ) const
+    {
+        const size_t granularity = bytes >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : m_pageSize;
+        return ( bytes + granularity - 1 ) / granularity * granularity;
+    }
+
+    static void unmap( const Mapping& m )
+    {
+        munmap( m.data, m.capacity );
+    }
+
+    void unmapAll()
+    {
+        for ( const Mapping& m : m_free ) {
+            unmap( m );
+        }
+        m_free.clear();
+        m_freeBytes = 0;
+    }
+
+    void trimLoop()
+    {
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        while ( !m_quit ) {
+            if ( m_free.empty() ) {
+                m_idle.wait( lock );
+                continue;
+            }
+            const auto deadline = m_lastUse + IDLE_TIMEOUT;
+            if ( std::chrono::steady_clock::now() >= deadline ) {
+                unmapAll();
+                continue;
+            }
+            m_idle.wait_until( lock, deadline );
+        }
+    }
+
+public:
+    explicit BufferPool( size_t highWater )
+    : m_highWater{ highWater }
+    {
+        m_trimThread = std::thread{ &BufferPool::trimLoop, this };
+    }
+
+    ~BufferPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_quit = true;
+        }
+        m_idle.notify_one();
+        m_trimThread.join();
+        unmapAll();
+    }
+
+    BufferPool( const BufferPool& ) = delete;
+    BufferPool& operator = ( const BufferPool& ) = delete;
+
+    // NOTE: contents are undefined, reused mappings are not cleared
+    std::pair<void*, size_t> acquire( size_t bytes )
+    {
+        const size_t capacity = roundCapacity( std::max<size_t>( bytes, 1 ) );
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_lastUse = std::chrono::steady_clock::now();
+            // NOTE: best fit, but don't hand out mappings more than twice the size asked for
+            auto best = m_free.end();
+            for ( auto it = m_free.begin(); it != m_free.end(); ++it ) {
+                if ( it->capacity < capacity || it->capacity > capacity * 2 ) continue;
+                if ( best == m_free.end() || it->capacity < best->capacity ) best = it;
+            }
+            if ( best != m_free.end() ) {
+                const Mapping m = *best;
+                m_free.erase( best );
+                m_freeBytes -= m.capacity;
+                return { m.data, m.capacity };
+            }
+        }
+
+        void* data = mmap( nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( data == MAP_FAILED ) {
+            return { nullptr, 0 };
+        }
+#ifdef MADV_HUGEPAGE
+        if ( capacity >= HUGE_PAGE_SIZE ) {
+            madvise( data, capacity, MADV_HUGEPAGE );
+        }
+#endif
+        return { data, capacity };
+    }
+
+    void release( void* data, size_t capacity )
+    {
+        if ( !data ) return;
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_lastUse = std::chrono::steady_clock::now();
+            if ( m_freeBytes + capacity <= m_highWater && m_free.size() < MAX_FREE_MAPPINGS ) {
+                m_free.push_back( Mapping{ data, capacity } );
+                m_freeBytes += capacity;
+                data = nullptr;
+            }
+        }
+        if ( data ) {
+            unmap( Mapping{ data, capacity } );
+            return;
+        }
+        m_idle.notify_one();
+    }
+
+    void trim()
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        unmapAll();
+    }
+};
+
+// NOTE: minimal QVector-like owner of pool memory, trivially copyable elements only
+template <typename T>
+class Buffer {
+    static_assert( std::is_trivially_copyable_v<T> );
+
+    BufferPool* m_pool = nullptr;
+    T* m_data = nullptr;
+    int64_t m_size = 0;
+    size_t m_capacity = 0;
+
+public:
+    Buffer() = default;
+    Buffer( BufferPool& pool, int64_t size )
+    : m_pool{ &pool }
+    {
+        assert( size >= 0 );
+        auto [ data, capacity ] = pool.acquire( static_cast<size_t>( size ) * sizeof( T ) );
+        if ( !data ) return;
+        m_data = reinterpret_cast<T*>( data );
+        m_size = size;
+        m_capacity = capacity;
+    }
+
+    ~Buffer()
+    {
+        if ( m_pool ) m_pool->release( m_data, m_capacity );
+    }
+
+    Buffer( const Buffer& ) = delete;
+    Buffer& operator = ( const Buffer& ) = delete;
+
+    Buffer( Buffer&& rhs ) noexcept
+    : m_pool{ std::exchange( rhs.m_pool, nullptr ) }
+    , m_data{ std::exchange( rhs.m_data, nullptr ) }
+    , m_size{ std::exchange( rhs.m_size, 0 ) }
+    , m_capacity{ std::exchange( rhs.m_capacity, 0 ) }
+    {}
+
+    Buffer& operator = ( Buffer&& rhs ) noexcept
+    {
+        std::swap( m_pool, rhs.m_pool );
+        std::swap( m_data, rhs.m_data );
+        std::swap( m_size, rhs.m_size );
+        std::swap( m_capacity, rhs.m_capacity );
+        return *this;
+    }
+
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+    int64_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T* begin() { return m_data; }
+    T* end() { return m_data + m_size; }
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+    T& operator [] ( int64_t i ) { assert( i < m_size ); return m_data[ i ]; }
+    const T& operator [] ( int64_t i ) const { assert( i < m_size ); return m_data[ i ]; }
+};
+
+} // namespace
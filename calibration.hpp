@@ -0,0 +1,271 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QString>
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "ddsdecode.hpp"
+#include "ddsdecoder.hpp"
+
+namespace {
+
+// NOTE: decode cost of every format measured over synthetic blocks the first time the plugin loads,
+//       kept in a small text file and measured again once the CPU model or the plugin binary changes.
+//       Measuring runs on a background thread, requests made meanwhile use built in guesses
+class Calibration {
+public:
+    static constexpr uint32_t SAMPLE_EXTENT = 256;
+    static constexpr std::chrono::milliseconds SAMPLE_TIME{ 8 };
+
+private:
+    struct Sample {
+        dds::Codec codec;
+        uint32_t bytesPerPixel; // 0 for block compressed
+        uint32_t blockBytes;
+        uint32_t masks[ 4 ];
+    };
+
+    // NOTE: one per codec, deswizzle costs about the same at any width so 32 bit stands for all
+    static constexpr Sample SAMPLES[] = {
+        { dds::Codec::eBC1, 0, 8, {} },
+        { dds::Codec::eBC2, 0, 16, {} },
+        { dds::Codec::eBC3, 0, 16, {} },
+        { dds::Codec::eBC4, 0, 8, {} },
+        { dds::Codec::eBC5, 0, 16, {} },
+        { dds::Codec::eBC7, 0, 16, {} },
+        { dds::Codec::eB8G8R8A8, 4, 0, {} },
+        { dds::Codec::eB8G8R8, 3, 0, {} },
+        { dds::Codec::eB5G6R5, 2, 0, {} },
+        { dds::Codec::eB5G5R5A1, 2, 0, {} },
+        { dds::Codec::eB4G4R4A4, 2, 0, {} },
+        { dds::Codec::eR8, 1, 0, {} },
+        { dds::Codec::eDeswizzle, 4, 0, { 0x000000FFu, 0x0000FF00u, 0x00FF0000u, 0xFF000000u } },
+    };
+
+    static dds::Layout sampleLayout( const Sample& sample )
+    {
+        dds::Layout layout{};
+        layout.codec = sample.codec;
+        layout.width = SAMPLE_EXTENT;
+        layout.height = SAMPLE_EXTENT;
+        layout.oWidth = SAMPLE_EXTENT;
+        layout.oHeight = SAMPLE_EXTENT;
+        layout.bytesPerPixel = sample.bytesPerPixel;
+        std::copy( std::begin( sample.masks ), std::end( sample.masks ), std::begin( layout.masks ) );
+        if ( sample.blockBytes ) {
+            layout.texelsPerRow = 4;
+            layout.rowPitch = (uint64_t)( SAMPLE_EXTENT / 4 ) * sample.blockBytes;
+            layout.rowCount = SAMPLE_EXTENT / 4;
+        }
+        else {
+            layout.rowPitch = (uint64_t)SAMPLE_EXTENT * sample.bytesPerPixel;
+            layout.rowCount = SAMPLE_EXTENT;
+        }
+        return layout;
+    }
+
+    // NOTE: BC7 modes in proportion encoders pick them for ddscorpus images, mostly 6, 5 and 3.
+    //       Random bytes would almost all land in mode 0, lowest set bit of the first byte picks the mode
+    static constexpr uint8_t BC7_MODES[ 32 ] = {
+        6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+        5, 5, 5, 5, 5, 5, 5, 5,
+        3, 3, 3, 3, 3, 3, 3, 3,
+        1, 1, 4, 0,
+    };
+
+    // NOTE: random blocks take every index path, BC7 blocks draw their mode at random so branches can't be learned
+    static std::vector<uint8_t> samplePayload( const dds::Layout& layout )
+    {
+        std::vector<uint8_t> ret( layout.bytes() );
+        uint32_t state = 0x2545F491u;
+        auto next = [&state]()
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        };
+        for ( uint8_t& byte : ret ) {
+            byte = static_cast<uint8_t>( next() >> 24 );
+        }
+        if ( layout.codec == dds::Codec::eBC7 ) {
+            for ( size_t i = 0; i < ret.size(); i += 16 ) {
+                const uint32_t mode = BC7_MODES[ next() >> 27 ];
+                ret[ i ] = static_cast<uint8_t>( ( ret[ i ] << ( mode + 1 ) ) | ( 1u << mode ) );
+            }
+        }
+        return ret;
+    }
+
+    // NOTE: best of as many runs as fit in SAMPLE_TIME, least disturbed by other workers starting at once
+    static double measure( const Sample& sample, std::vector<uint32_t>& pixels )
+    {
+        using Clock = std::chrono::steady_clock;
+        const dds::Layout layout = sampleLayout( sample );
+        const std::vector<uint8_t> payload = samplePayload( layout );
+        const dds::Span<const uint8_t> span{ payload.data(), payload.size() };
+        double best = 0.0;
+        const Clock::time_point end = Clock::now() + SAMPLE_TIME;
+        for ( uint32_t runs = 0; runs < 3 || Clock::now() < end; ++runs ) {
+            const Clock::time_point begin = Clock::now();
+            if ( !dds::decode( layout, span, pixels.data(), SAMPLE_EXTENT * sizeof( uint32_t ) ) ) return 0.0;
+            const double ns = std::chrono::duration<double, std::nano>( Clock::now() - begin ).count();
+            best = runs ? std::min( best, ns ) : ns;
+        }
+        return best / ( (double)SAMPLE_EXTENT * SAMPLE_EXTENT );
+    }
+
+    // NOTE: false when cancelled part way, costs then hold only what was measured
+    static bool measureAll( DecodeCosts& costs, const std::atomic<bool>& cancel )
+    {
+        std::vector<uint32_t> pixels( SAMPLE_EXTENT * SAMPLE_EXTENT );
+        for ( const Sample& sample : SAMPLES ) {
+            if ( cancel.load( std::memory_order_relaxed ) ) return false;
+            costs.nsPerTexel[ static_cast<size_t>( sample.codec ) ] = measure( sample, pixels );
+        }
+        return true;
+    }
+
+    static QByteArray cpuModel()
+    {
+        QFile file{ QStringLiteral( "/proc/cpuinfo" ) };
+        if ( !file.open( QIODevice::ReadOnly ) ) return {};
+        for ( QByteArray line = file.readLine(); !line.isEmpty(); line = file.readLine() ) {
+            if ( line.startsWith( "model name" ) ) return line.mid( line.indexOf( ':' ) + 1 ).trimmed();
+        }
+        return {};
+    }
+
+    // NOTE: the binary holding this code, its size and modification time change with every build
+    static QByteArray pluginBuild()
+    {
+        Dl_info info{};
+        if ( !dladdr( reinterpret_cast<const void*>( &Calibration::measure ), &info ) || !info.dli_fname ) return {};
+        const QFileInfo binary{ QFile::decodeName( info.dli_fname ) };
+        return QFile::encodeName( binary.absoluteFilePath() )
+            + ' ' + QByteArray::number( binary.size() )
+            + ' ' + QByteArray::number( binary.lastModified().toSecsSinceEpoch() );
+    }
+
+    static QByteArray identity()
+    {
+        return "cpu " + cpuModel() + "\nplugin " + pluginBuild() + "\n";
+    }
+
+    // NOTE: identity lines, then a name and cost per line
+    static bool load( const QString& path, const QByteArray& identity, DecodeCosts& costs )
+    {
+        QFile file{ path };
+        if ( !file.open( QIODevice::ReadOnly ) ) return false;
+        const QByteArray data = file.readAll();
+        if ( !data.startsWith( identity ) ) return false;
+
+        DecodeCosts ret{};
+        const QList<QByteArray> lines = data.mid( identity.size() ).split( '\n' );
+        for ( const QByteArray& line : lines ) {
+            const QList<QByteArray> fields = line.split( ' ' );
+            if ( fields.size() != 2 ) continue;
+            for ( const Sample& sample : SAMPLES ) {
+                if ( fields[ 0 ] == dds::name( sample.codec ) ) {
+                    ret.nsPerTexel[ static_cast<size_t>( sample.codec ) ] = fields[ 1 ].toDouble();
+                }
+            }
+        }
+        costs = ret;
+        return true;
+    }
+
+    static void store( const QString& path, const QByteArray& identity, const DecodeCosts& costs )
+    {
+        QByteArray data = identity;
+        for ( const Sample& sample : SAMPLES ) {
+            data += QByteArray{ dds::name( sample.codec ) } + ' '
+                + QByteArray::number( costs.nsPerTexel[ static_cast<size_t>( sample.codec ) ], 'g', 4 ) + '\n';
+        }
+        QDir{}.mkpath( QFileInfo{ path }.absolutePath() );
+        QSaveFile file{ path };
+        if ( !file.open( QIODevice::WriteOnly ) ) return;
+        file.write( data );
+        file.commit();
+    }
+
+    DecodeCosts m_costs{};
+    std::atomic<bool> m_ready = false;
+    std::atomic<bool> m_cancel = false;
+    std::thread m_thread{};
+
+public:
+    Calibration() = default;
+
+    // NOTE: a few workers starting at once may all measure, the file is replaced atomically by each of them.
+    //       Empty path keeps built in guesses
+    explicit Calibration( const QString& path )
+    {
+        if ( path.isEmpty() ) return;
+        const QByteArray id = identity();
+        if ( load( path, id, m_costs ) ) {
+            m_ready.store( true, std::memory_order_release );
+            return;
+        }
+        m_thread = std::thread{ [this, path, id]
+        {
+            DecodeCosts measured{};
+            if ( !measureAll( measured, m_cancel ) ) return;
+            m_costs = measured;
+            m_ready.store( true, std::memory_order_release );
+            store( path, id, measured );
+        } };
+    }
+
+    // NOTE: plugin unloading mid measurement skips the remaining formats and stores nothing
+    ~Calibration()
+    {
+        m_cancel.store( true, std::memory_order_relaxed );
+        if ( m_thread.joinable() ) m_thread.join();
+    }
+
+    Calibration( const Calibration& ) = delete;
+    Calibration& operator = ( const Calibration& ) = delete;
+
+    // NOTE: null until measured, DecodeContext then falls back to built in guesses
+    const DecodeCosts* costs() const
+    {
+        return m_ready.load( std::memory_order_acquire ) ? &m_costs : nullptr;
+    }
+};
+
+} // namespace
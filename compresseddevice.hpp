@@ -0,0 +1,132 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// gzip trailer https://www.rfc-editor.org/rfc/rfc1952#section-2.3
+// zstd frame header https://www.rfc-editor.org/rfc/rfc8878#section-3.1.1.1
+
+#pragma once
+
+#include <KCompressionDevice>
+#include <QIODevice>
+
+#include <cstdint>
+#include <memory>
+
+#ifndef NDEBUG
+#include <iostream>
+#define LOG( msg ) std::cerr << ( msg ) << "\n";
+#else
+#define LOG( msg ) {}
+#endif
+
+namespace {
+
+// NOTE: decompresses on the fly as the decoder reads, seeking forward inflates and discards,
+//       so nothing past the selected mip level is ever decompressed.
+//       KCompressionDevice does not know the decompressed size, decoder bounds checks need it.
+class CompressedDevice : public KCompressionDevice {
+    qint64 m_size = 0;
+
+public:
+    CompressedDevice( QIODevice* source, CompressionType type, qint64 size )
+    : KCompressionDevice( source, true, type )
+    , m_size{ size }
+    {}
+
+    qint64 size() const override
+    {
+        return m_size;
+    }
+};
+
+inline uint64_t readLE( const uint8_t* data, int bytes )
+{
+    uint64_t value = 0;
+    for ( int i = bytes - 1; i >= 0; --i ) {
+        value = ( value << 8 ) | data[ i ];
+    }
+    return value;
+}
+
+// NOTE: ISIZE is modulo 2^32 and describes the last member only, good enough for single texture files
+inline qint64 gzipSize( QIODevice* source )
+{
+    uint8_t trailer[ 4 ]{};
+    if ( source->size() < 18 ) return 0;
+    if ( !source->seek( source->size() - 4 ) ) return 0;
+    if ( source->read( reinterpret_cast<char*>( trailer ), 4 ) != 4 ) return 0;
+    return static_cast<qint64>( readLE( trailer, 4 ) );
+}
+
+// NOTE: content size is optional in zstd frame header, the reference encoder writes it for files
+inline qint64 zstdSize( const uint8_t* frame )
+{
+    const uint8_t descriptor = frame[ 4 ];
+    const uint32_t fcsFlag = descriptor >> 6;
+    const bool singleSegment = descriptor & 0x20;
+    static constexpr int DICTIONARY_ID_BYTES[] = { 0, 1, 2, 4 };
+    const uint8_t* it = frame + 5 + ( singleSegment ? 0 : 1 ) + DICTIONARY_ID_BYTES[ descriptor & 0x3 ];
+    switch ( fcsFlag ) {
+    case 0: return singleSegment ? static_cast<qint64>( it[ 0 ] ) : 0;
+    case 1: return static_cast<qint64>( readLE( it, 2 ) + 256 );
+    case 2: return static_cast<qint64>( readLE( it, 4 ) );
+    default: return static_cast<qint64>( readLE( it, 8 ) );
+    }
+}
+
+// NOTE: takes opened source, returns it as is when not compressed, null when compressed but unusable
+inline std::unique_ptr<QIODevice> openDecompressed( std::unique_ptr<QIODevice> source )
+{
+    static constexpr int ZSTD_MAX_FRAME_HEADER = 18;
+    uint8_t head[ ZSTD_MAX_FRAME_HEADER ]{};
+    const qint64 headBytes = source->peek( reinterpret_cast<char*>( head ), sizeof( head ) );
+    if ( headBytes < 4 ) return source;
+
+    KCompressionDevice::CompressionType type{};
+    qint64 size = 0;
+    if ( head[ 0 ] == 0x1f && head[ 1 ] == 0x8b ) {
+        type = KCompressionDevice::GZip;
+        size = gzipSize( source.get() );
+    }
+    else if ( readLE( head, 4 ) == 0xFD2FB528 && headBytes == sizeof( head ) ) {
+        type = KCompressionDevice::Zstd;
+        size = zstdSize( head );
+    }
+    else {
+        return source;
+    }
+
+    if ( size <= 0 ) {
+        LOG( "Compressed file does not tell its decompressed size" );
+        return {};
+    }
+    if ( !source->seek( 0 ) ) return {};
+
+    auto device = std::make_unique<CompressedDevice>( source.release(), type, size );
+    if ( !device->open( QIODevice::ReadOnly ) ) {
+        LOG( "Decompression not available" );
+        return {};
+    }
+    return device;
+}
+
+} // namespace
@@ -0,0 +1,784 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Writes a deterministic set of DDS files covering every header path the decoder handles,
+// then reads each one back through ddsdecode and reports how close it decodes to the source image.
+// usage: ddscorpus [--seed N] [--size N] output-directory
+
+#include "bcencode.hpp"
+#include "ddsdecode.hpp"
+#include "ddsformat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using dds::DDSHeader;
+using dds::DXGIHeader;
+using dds::PixelFormat;
+using dds::XBOXHeader;
+using namespace dds; // DXGI_FORMAT_* enumerators
+
+enum class Encoding : uint32_t {
+    eBC1,
+    eBC1A, // punch-through alpha
+    eBC2,
+    eBC3,
+    eBC4,
+    eBC5,
+    eBC7,
+    eB8G8R8A8,
+    eB8G8R8X8,
+    eR8G8B8A8,
+    eB8G8R8,
+    eB5G6R5,
+    eB5G5R5A1,
+    eB4G4R4A4,
+    eR8,
+    eA8,
+};
+
+enum class Content : uint32_t {
+    eColor,
+    eAlpha, // smooth alpha
+    eCutout, // alpha either 0 or 255
+    eGray,
+    eNormal, // tangent space normal map in red and green
+};
+
+enum class Container : uint32_t {
+    eFourCC,
+    eRGB,
+    eDX10,
+    eXbox,
+};
+
+struct Variant {
+    std::string name;
+    Encoding encoding;
+    Content content;
+    Container container;
+    uint32_t code; // fourCC or DXGI format
+    uint32_t width;
+    uint32_t height;
+    bool mips = false;
+    uint32_t depth = 1;
+    uint32_t arraySize = 1;
+    bool cubemap = false;
+    uint32_t pitchAlign = 0; // uncompressed only, 0 leaves pitch flag unset
+    uint32_t tileMode = XBOXHeader::eLinear; // Xbox container only
+};
+
+struct Image {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<Texel> texels{};
+
+    Image() = default;
+    Image( uint32_t w, uint32_t h )
+    : width{ w }
+    , height{ h }
+    , texels( (size_t)w * h )
+    {}
+
+    Texel& at( uint32_t x, uint32_t y ) { return texels[ (size_t)y * width + x ]; }
+    const Texel& at( uint32_t x, uint32_t y ) const { return texels[ (size_t)y * width + x ]; }
+};
+
+static uint32_t hash( uint32_t x, uint32_t y, uint32_t seed )
+{
+    uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+}
+
+static float valueNoise( float x, float y, uint32_t seed )
+{
+    const float fx = std::floor( x );
+    const float fy = std::floor( y );
+    const uint32_t ix = static_cast<uint32_t>( static_cast<int32_t>( fx ) );
+    const uint32_t iy = static_cast<uint32_t>( static_cast<int32_t>( fy ) );
+    auto lattice = [seed]( uint32_t lx, uint32_t ly ) { return static_cast<float>( hash( lx, ly, seed ) & 0xFFFF ) / 65535.0f; };
+    auto smooth = []( float t ) { return t * t * ( 3.0f - 2.0f * t ); };
+    const float tx = smooth( x - fx );
+    const float ty = smooth( y - fy );
+    const float top = lattice( ix, iy ) + ( lattice( ix + 1, iy ) - lattice( ix, iy ) ) * tx;
+    const float bottom = lattice( ix, iy + 1 ) + ( lattice( ix + 1, iy + 1 ) - lattice( ix, iy + 1 ) ) * tx;
+    return top + ( bottom - top ) * ty;
+}
+
+static float fractal( float x, float y, uint32_t seed )
+{
+    float sum = 0.0f;
+    float amplitude = 0.5f;
+    for ( uint32_t octave = 0; octave < 4; ++octave ) {
+        sum += valueNoise( x, y, seed + octave ) * amplitude;
+        x *= 2.0f;
+        y *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    return sum / 0.9375f;
+}
+
+static uint8_t toByte( float v )
+{
+    return static_cast<uint8_t>( std::clamp( v, 0.0f, 255.0f ) + 0.5f );
+}
+
+// NOTE: material-like content, smooth gradients under flat painted shapes with hard edges
+//       and a band of fine detail, so blocks range from uniform to high contrast like real textures
+static Image synthesize( uint32_t width, uint32_t height, Content content, uint32_t seed )
+{
+    std::mt19937 rng{ seed };
+    auto randomColor = [&rng]() { return Texel{ (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng(), 255 }; };
+    auto randomFloat = [&rng]( float lo, float hi ) { return std::uniform_real_distribution<float>{ lo, hi }( rng ); };
+
+    const Texel from = randomColor();
+    const Texel to = randomColor();
+    const float period = std::max( std::max( width, height ) / 4.0f, 4.0f );
+
+    struct Shape {
+        bool disc;
+        float x, y, w, h;
+        Texel color;
+    };
+    std::vector<Shape> shapes( 6 );
+    for ( Shape& s : shapes ) {
+        s.disc = rng() & 1;
+        s.x = randomFloat( 0.0f, (float)width );
+        s.y = randomFloat( 0.0f, (float)height );
+        s.w = randomFloat( 0.05f, 0.3f ) * width;
+        s.h = s.disc ? s.w : randomFloat( 0.05f, 0.3f ) * height;
+        s.color = randomColor();
+    }
+    const float detailTop = randomFloat( 0.0f, 0.7f ) * height;
+    const float detailBottom = detailTop + height * 0.15f;
+
+    Image image{ width, height };
+    for ( uint32_t y = 0; y < height; ++y ) {
+        for ( uint32_t x = 0; x < width; ++x ) {
+            const float n = fractal( x / period, y / period, seed );
+            float rgb[ 3 ]{};
+            for ( uint32_t c = 0; c < 3; ++c ) rgb[ c ] = from[ c ] + ( to[ c ] - from[ c ] ) * n;
+            for ( const Shape& s : shapes ) {
+                const float dx = x - s.x;
+                const float dy = y - s.y;
+                const bool inside = s.disc
+                    ? dx * dx + dy * dy < s.w * s.w
+                    : dx >= 0.0f && dy >= 0.0f && dx < s.w && dy < s.h;
+                if ( inside ) for ( uint32_t c = 0; c < 3; ++c ) rgb[ c ] = s.color[ c ];
+            }
+            if ( y >= detailTop && y < detailBottom ) {
+                const float grain = static_cast<float>( hash( x, y, seed ^ 0x5bd1e995u ) & 0xFF ) - 127.5f;
+                for ( float& c : rgb ) c += grain * 0.35f;
+            }
+
+            Texel& t = image.at( x, y );
+            t = Texel{ toByte( rgb[ 0 ] ), toByte( rgb[ 1 ] ), toByte( rgb[ 2 ] ), 255 };
+            const float a = fractal( x / period, y / period, seed + 16 );
+            switch ( content ) {
+            case Content::eAlpha: t[ 3 ] = toByte( ( a - 0.35f ) * 3.0f * 255.0f ); break;
+            case Content::eCutout: t[ 3 ] = a > 0.5f ? 255 : 0; break;
+            case Content::eGray: t[ 0 ] = t[ 1 ] = t[ 2 ] = toByte( 0.299f * rgb[ 0 ] + 0.587f * rgb[ 1 ] + 0.114f * rgb[ 2 ] ); break;
+            default: break;
+            }
+        }
+    }
+
+    if ( content == Content::eNormal ) {
+        const Image height0 = image;
+        auto h = [&height0]( int32_t x, int32_t y ) {
+            x = std::clamp<int32_t>( x, 0, height0.width - 1 );
+            y = std::clamp<int32_t>( y, 0, height0.height - 1 );
+            return static_cast<float>( height0.at( x, y )[ 1 ] );
+        };
+        for ( uint32_t y = 0; y < height; ++y ) {
+            for ( uint32_t x = 0; x < width; ++x ) {
+                const float dx = ( h( x + 1, y ) - h( x - 1, y ) ) / 255.0f * 4.0f;
+                const float dy = ( h( x, y + 1 ) - h( x, y - 1 ) ) / 255.0f * 4.0f;
+                const float length = std::sqrt( dx * dx + dy * dy + 1.0f );
+                image.at( x, y ) = Texel{
+                    toByte( ( -dx / length * 0.5f + 0.5f ) * 255.0f ),
+                    toByte( ( -dy / length * 0.5f + 0.5f ) * 255.0f ),
+                    toByte( 1.0f / length * 255.0f ),
+                    255,
+                };
+            }
+        }
+    }
+    return image;
+}
+
+static Image downsample( const Image& src )
+{
+    Image dst{ std::max( src.width / 2, 1u ), std::max( src.height / 2, 1u ) };
+    for ( uint32_t y = 0; y < dst.height; ++y ) {
+        for ( uint32_t x = 0; x < dst.width; ++x ) {
+            const uint32_t x0 = std::min( x * 2, src.width - 1 );
+            const uint32_t x1 = std::min( x * 2 + 1, src.width - 1 );
+            const uint32_t y0 = std::min( y * 2, src.height - 1 );
+            const uint32_t y1 = std::min( y * 2 + 1, src.height - 1 );
+            for ( uint32_t c = 0; c < 4; ++c ) {
+                const uint32_t sum = src.at( x0, y0 )[ c ] + src.at( x1, y0 )[ c ] + src.at( x0, y1 )[ c ] + src.at( x1, y1 )[ c ];
+                dst.at( x, y )[ c ] = static_cast<uint8_t>( ( sum + 2 ) / 4 );
+            }
+        }
+    }
+    return dst;
+}
+
+static Image average( const Image& lhs, const Image& rhs )
+{
+    Image ret = lhs;
+    for ( size_t i = 0; i < ret.texels.size(); ++i ) {
+        for ( uint32_t c = 0; c < 4; ++c ) {
+            ret.texels[ i ][ c ] = static_cast<uint8_t>( ( lhs.texels[ i ][ c ] + rhs.texels[ i ][ c ] + 1 ) / 2 );
+        }
+    }
+    return ret;
+}
+
+static bool isBlockCompressed( Encoding encoding )
+{
+    switch ( encoding ) {
+    case Encoding::eBC1:
+    case Encoding::eBC1A:
+    case Encoding::eBC2:
+    case Encoding::eBC3:
+    case Encoding::eBC4:
+    case Encoding::eBC5:
+    case Encoding::eBC7:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static uint32_t blockBytes( Encoding encoding )
+{
+    switch ( encoding ) {
+    case Encoding::eBC1:
+    case Encoding::eBC1A:
+    case Encoding::eBC4:
+        return 8;
+    default:
+        return 16;
+    }
+}
+
+static uint32_t bytesPerPixel( Encoding encoding )
+{
+    switch ( encoding ) {
+    case Encoding::eB8G8R8A8:
+    case Encoding::eB8G8R8X8:
+    case Encoding::eR8G8B8A8:
+        return 4;
+    case Encoding::eB8G8R8:
+        return 3;
+    case Encoding::eB5G6R5:
+    case Encoding::eB5G5R5A1:
+    case Encoding::eB4G4R4A4:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+static uint32_t rowPitch( const Variant& v, uint32_t width )
+{
+    const uint32_t tight = width * bytesPerPixel( v.encoding );
+    const uint32_t align = std::max( v.pitchAlign, 1u );
+    return ( tight + align - 1 ) / align * align;
+}
+
+static void encodeBlocks( Encoding encoding, const Image& image, std::vector<uint8_t>& out, bcenc::BC7Stats& stats )
+{
+    const uint32_t blocksX = ( image.width + 3 ) / 4;
+    const uint32_t blocksY = ( image.height + 3 ) / 4;
+    const uint32_t bytes = blockBytes( encoding );
+    const size_t begin = out.size();
+    out.resize( begin + (size_t)blocksX * blocksY * bytes );
+    uint8_t* dst = out.data() + begin;
+    Texel block[ 16 ]{};
+    for ( uint32_t by = 0; by < blocksY; ++by ) {
+        for ( uint32_t bx = 0; bx < blocksX; ++bx, dst += bytes ) {
+            // NOTE: edge texels replicated into padding, what most encoders do
+            for ( uint32_t i = 0; i < 16; ++i ) {
+                const uint32_t x = std::min( bx * 4 + i % 4, image.width - 1 );
+                const uint32_t y = std::min( by * 4 + i / 4, image.height - 1 );
+                block[ i ] = image.at( x, y );
+            }
+            switch ( encoding ) {
+            case Encoding::eBC1: bcenc::encodeBC1( block, false, dst ); break;
+            case Encoding::eBC1A: bcenc::encodeBC1( block, true, dst ); break;
+            case Encoding::eBC2: bcenc::encodeBC2( block, dst ); break;
+            case Encoding::eBC3: bcenc::encodeBC3( block, dst ); break;
+            case Encoding::eBC4: bcenc::encodeBC4( block, 0, dst ); break;
+            case Encoding::eBC5: bcenc::encodeBC5( block, dst ); break;
+            case Encoding::eBC7: bcenc::encodeBC7( block, dst, &stats ); break;
+            default: break;
+            }
+        }
+    }
+}
+
+static void encodeTexels( const Variant& v, const Image& image, std::vector<uint8_t>& out )
+{
+    const uint32_t pitch = rowPitch( v, image.width );
+    const uint32_t bpp = bytesPerPixel( v.encoding );
+    const size_t begin = out.size();
+    out.resize( begin + (size_t)pitch * image.height );
+    for ( uint32_t y = 0; y < image.height; ++y ) {
+        uint8_t* dst = out.data() + begin + (size_t)y * pitch;
+        for ( uint32_t x = 0; x < image.width; ++x, dst += bpp ) {
+            const Texel& t = image.at( x, y );
+            const uint32_t r = t[ 0 ];
+            const uint32_t g = t[ 1 ];
+            const uint32_t b = t[ 2 ];
+            const uint32_t a = t[ 3 ];
+            uint32_t value = 0;
+            switch ( v.encoding ) {
+            case Encoding::eB8G8R8A8: value = ( a << 24 ) | ( r << 16 ) | ( g << 8 ) | b; break;
+            case Encoding::eB8G8R8X8: value = ( r << 16 ) | ( g << 8 ) | b; break;
+            case Encoding::eR8G8B8A8: value = ( a << 24 ) | ( b << 16 ) | ( g << 8 ) | r; break;
+            case Encoding::eB8G8R8: value = ( r << 16 ) | ( g << 8 ) | b; break;
+            case Encoding::eB5G6R5: value = ( ( r * 31 + 127 ) / 255 << 11 ) | ( ( g * 63 + 127 ) / 255 << 5 ) | ( b * 31 + 127 ) / 255; break;
+            case Encoding::eB5G5R5A1: value = ( ( a >> 7 ) << 15 ) | ( ( r * 31 + 127 ) / 255 << 10 ) | ( ( g * 31 + 127 ) / 255 << 5 ) | ( b * 31 + 127 ) / 255; break;
+            case Encoding::eB4G4R4A4: value = ( ( a * 15 + 127 ) / 255 << 12 ) | ( ( r * 15 + 127 ) / 255 << 8 ) | ( ( g * 15 + 127 ) / 255 << 4 ) | ( b * 15 + 127 ) / 255; break;
+            case Encoding::eR8: value = r; break;
+            case Encoding::eA8: value = a; break;
+            default: break;
+            }
+            for ( uint32_t i = 0; i < bpp; ++i ) dst[ i ] = static_cast<uint8_t>( value >> ( i * 8 ) );
+        }
+    }
+}
+
+static void encodeSurface( const Variant& v, const Image& image, std::vector<uint8_t>& out, bcenc::BC7Stats& stats )
+{
+    if ( isBlockCompressed( v.encoding ) ) {
+        encodeBlocks( v.encoding, image, out, stats );
+    }
+    else {
+        encodeTexels( v, image, out );
+    }
+}
+
+static PixelFormat legacyPixelFormat( Encoding encoding )
+{
+    auto make = []( uint32_t flags, uint32_t bitCount, uint32_t r, uint32_t g, uint32_t b, uint32_t a ) {
+        PixelFormat ret{};
+        ret.size = sizeof( PixelFormat );
+        ret.flags = static_cast<PixelFormat::Flags>( flags );
+        ret.rgbBitCount = bitCount;
+        ret.bitmaskR = r;
+        ret.bitmaskG = g;
+        ret.bitmaskB = b;
+        ret.bitmaskA = a;
+        return ret;
+    };
+    const uint32_t rgba = PixelFormat::fRGB | PixelFormat::fAlphaPixels;
+    switch ( encoding ) {
+    case Encoding::eB8G8R8A8: return make( rgba, 32, 0x00FF0000u, 0x0000FF00u, 0x000000FFu, 0xFF000000u );
+    case Encoding::eB8G8R8X8: return make( PixelFormat::fRGB, 32, 0x00FF0000u, 0x0000FF00u, 0x000000FFu, 0u );
+    case Encoding::eR8G8B8A8: return make( rgba, 32, 0x000000FFu, 0x0000FF00u, 0x00FF0000u, 0xFF000000u );
+    case Encoding::eB8G8R8: return make( PixelFormat::fRGB, 24, 0x00FF0000u, 0x0000FF00u, 0x000000FFu, 0u );
+    case Encoding::eB5G6R5: return make( PixelFormat::fRGB, 16, 0xF800u, 0x07E0u, 0x001Fu, 0u );
+    case Encoding::eB5G5R5A1: return make( rgba, 16, 0x7C00u, 0x03E0u, 0x001Fu, 0x8000u );
+    case Encoding::eB4G4R4A4: return make( rgba, 16, 0x0F00u, 0x00F0u, 0x000Fu, 0xF000u );
+    case Encoding::eR8: return make( PixelFormat::fLuminance, 8, 0xFFu, 0u, 0u, 0u );
+    case Encoding::eA8: return make( PixelFormat::fAlpha, 8, 0u, 0u, 0u, 0xFFu );
+    default: return {};
+    }
+}
+
+static uint32_t mipCount( const Variant& v )
+{
+    if ( !v.mips ) return 1;
+    uint32_t count = 1;
+    for ( uint32_t extent = std::max( { v.width, v.height, v.depth } ); extent > 1; extent >>= 1 ) count++;
+    return count;
+}
+
+static std::vector<uint8_t> makeHeader( const Variant& v )
+{
+    DDSHeader header{};
+    header.magic = DDSHeader::MAGIC;
+    header.size = DDSHeader::SIZE;
+    header.width = v.width;
+    header.height = v.height;
+    uint32_t flags = DDSHeader::fCaps | DDSHeader::fHeight | DDSHeader::fWidth | DDSHeader::fPixelFormat;
+    uint32_t caps = DDSHeader::fTexture;
+    if ( v.mips ) {
+        flags |= DDSHeader::fMipMapCount;
+        caps |= DDSHeader::fComplex | DDSHeader::fMipMap;
+        header.mipMapCount = mipCount( v );
+    }
+    if ( v.depth > 1 ) {
+        flags |= DDSHeader::fDepth;
+        caps |= DDSHeader::fComplex;
+        header.depth = v.depth;
+        header.caps2 |= DDSHeader::fVolume;
+    }
+    if ( v.cubemap ) {
+        static constexpr uint32_t ALL_FACES = 0xFC00;
+        caps |= DDSHeader::fComplex;
+        header.caps2 |= DDSHeader::fCubemap | ALL_FACES;
+    }
+    if ( isBlockCompressed( v.encoding ) ) {
+        flags |= DDSHeader::fLinearSize;
+        header.pitchOrLinearSize = ( v.width + 3 ) / 4 * ( ( v.height + 3 ) / 4 ) * blockBytes( v.encoding );
+    }
+    else if ( v.pitchAlign ) {
+        flags |= DDSHeader::fPitch;
+        header.pitchOrLinearSize = rowPitch( v, v.width );
+    }
+
+    switch ( v.container ) {
+    case Container::eRGB:
+        header.pixelFormat = legacyPixelFormat( v.encoding );
+        break;
+    case Container::eFourCC:
+    case Container::eDX10:
+    case Container::eXbox:
+        header.pixelFormat.size = sizeof( PixelFormat );
+        header.pixelFormat.flags = PixelFormat::fFourCC;
+        header.pixelFormat.fourCC = v.container == Container::eDX10 ? '01XD'
+            : v.container == Container::eXbox ? 'XOBX'
+            : v.code;
+        break;
+    }
+    header.flags = static_cast<DDSHeader::Flags>( flags );
+    header.caps = static_cast<DDSHeader::Caps>( caps );
+
+    std::vector<uint8_t> ret( sizeof( DDSHeader ) );
+    std::memcpy( ret.data(), &header, sizeof( DDSHeader ) );
+    if ( v.container == Container::eDX10 ) {
+        DXGIHeader dxgi{};
+        dxgi.format = v.code;
+        dxgi.dimension = v.depth > 1 ? DXGIHeader::eTexture3D : DXGIHeader::eTexture2D;
+        dxgi.arraySize = v.arraySize;
+        ret.resize( sizeof( DDSHeader ) + sizeof( DXGIHeader ) );
+        std::memcpy( ret.data() + sizeof( DDSHeader ), &dxgi, sizeof( DXGIHeader ) );
+    }
+    if ( v.container == Container::eXbox ) {
+        XBOXHeader xbox{};
+        xbox.format = v.code;
+        xbox.dimension = DXGIHeader::eTexture2D;
+        xbox.arraySize = 1;
+        xbox.tileMode = v.tileMode;
+        xbox.baseAlignment = 256;
+        ret.resize( sizeof( DDSHeader ) + sizeof( XBOXHeader ) );
+        std::memcpy( ret.data() + sizeof( DDSHeader ), &xbox, sizeof( XBOXHeader ) );
+    }
+    return ret;
+}
+
+// NOTE: element order within a 8x8 micro tile spelled out bit by bit, written apart from the decoder to cross-check it
+static uint32_t microTileIndex( uint32_t tileMode, uint32_t elementBytes, uint32_t x, uint32_t y )
+{
+    const uint32_t x0 = x & 1, x1 = ( x >> 1 ) & 1, x2 = ( x >> 2 ) & 1;
+    const uint32_t y0 = y & 1, y1 = ( y >> 1 ) & 1, y2 = ( y >> 2 ) & 1;
+    if ( tileMode == XBOXHeader::eThin1D ) {
+        return x0 | y0 << 1 | x1 << 2 | y1 << 3 | x2 << 4 | y2 << 5;
+    }
+    switch ( elementBytes ) {
+    case 2: return x0 | x1 << 1 | x2 << 2 | y0 << 3 | y1 << 4 | y2 << 5;
+    case 4: return x0 | x1 << 1 | y0 << 2 | x2 << 3 | y1 << 4 | y2 << 5;
+    case 8: return x0 | y0 << 1 | x1 << 2 | x2 << 3 | y1 << 4 | y2 << 5;
+    default: return y0 | x0 << 1 | x1 << 2 | x2 << 3 | y1 << 4 | y2 << 5;
+    }
+}
+
+// NOTE: lays tightly packed elements out the way Xbox One GPU expects them for the tile mode, padding zeroed
+static std::vector<uint8_t> xboxSurface( const std::vector<uint8_t>& packed, uint32_t elementsX, uint32_t elementsY, uint32_t elementBytes, uint32_t tileMode )
+{
+    auto alignUp = []( uint32_t v, uint32_t a ) { return ( v + a - 1 ) / a * a; };
+    if ( tileMode == XBOXHeader::eLinear ) {
+        const uint32_t pitch = alignUp( elementsX, std::max( 64u, 256u / elementBytes ) );
+        std::vector<uint8_t> ret( (size_t)pitch * elementsY * elementBytes );
+        for ( uint32_t y = 0; y < elementsY; ++y ) {
+            std::memcpy( ret.data() + (size_t)y * pitch * elementBytes, packed.data() + (size_t)y * elementsX * elementBytes, (size_t)elementsX * elementBytes );
+        }
+        return ret;
+    }
+
+    const uint32_t pitch = alignUp( elementsX, std::max( 8u, 32u / elementBytes ) );
+    std::vector<uint8_t> ret( (size_t)pitch * alignUp( elementsY, 8 ) * elementBytes );
+    for ( uint32_t y = 0; y < elementsY; ++y ) {
+        for ( uint32_t x = 0; x < elementsX; ++x ) {
+            const size_t tile = (size_t)( y / 8 ) * ( pitch / 8 ) + x / 8;
+            const size_t element = tile * 64 + microTileIndex( tileMode, elementBytes, x % 8, y % 8 );
+            std::memcpy( ret.data() + element * elementBytes, packed.data() + ( (size_t)y * elementsX + x ) * elementBytes, elementBytes );
+        }
+    }
+    return ret;
+}
+
+// NOTE: array elements and cube faces each hold a full mip chain, volume mips hold all of their depth slices
+static std::vector<uint8_t> makeFile( const Variant& v, uint32_t seed, Image& top, bcenc::BC7Stats& stats )
+{
+    std::vector<uint8_t> file = makeHeader( v );
+    if ( v.container == Container::eXbox ) {
+        Image image = synthesize( v.width, v.height, v.content, seed );
+        top = image;
+        std::vector<uint8_t> packed{};
+        encodeSurface( v, image, packed, stats );
+        const bool blocks = isBlockCompressed( v.encoding );
+        const uint32_t extent = blocks ? 4 : 1;
+        const uint32_t elementBytes = blocks ? blockBytes( v.encoding ) : bytesPerPixel( v.encoding );
+        const std::vector<uint8_t> surface = xboxSurface( packed, ( v.width + extent - 1 ) / extent, ( v.height + extent - 1 ) / extent, elementBytes, v.tileMode );
+        const uint32_t dataSize = static_cast<uint32_t>( surface.size() );
+        std::memcpy( file.data() + sizeof( DDSHeader ) + offsetof( XBOXHeader, dataSize ), &dataSize, sizeof( dataSize ) );
+        file.insert( file.end(), surface.begin(), surface.end() );
+        return file;
+    }
+    const uint32_t elements = v.cubemap ? 6 : v.arraySize;
+    const uint32_t mips = mipCount( v );
+    for ( uint32_t element = 0; element < elements; ++element ) {
+        std::vector<Image> slices{};
+        for ( uint32_t z = 0; z < v.depth; ++z ) {
+            slices.push_back( synthesize( v.width, v.height, v.content, seed + element * 131 + z * 17 ) );
+        }
+        if ( element == 0 ) top = slices[ slices.size() / 2 ];
+
+        for ( uint32_t mip = 0; mip < mips; ++mip ) {
+            for ( const Image& slice : slices ) encodeSurface( v, slice, file, stats );
+            std::vector<Image> next{};
+            for ( size_t z = 0; z < slices.size(); z += 2 ) {
+                const Image lhs = downsample( slices[ z ] );
+                next.push_back( z + 1 < slices.size() ? average( lhs, downsample( slices[ z + 1 ] ) ) : lhs );
+            }
+            slices = std::move( next );
+        }
+    }
+    return file;
+}
+
+// NOTE: what a perfect decoder shows for the source texel, formats without some channels fill them in
+static Texel reference( Encoding encoding, const Texel& t )
+{
+    switch ( encoding ) {
+    case Encoding::eBC1:
+    case Encoding::eB8G8R8X8:
+    case Encoding::eB8G8R8:
+    case Encoding::eB5G6R5:
+        return Texel{ t[ 0 ], t[ 1 ], t[ 2 ], 255 };
+    case Encoding::eBC1A:
+        return t[ 3 ] < 128 ? Texel{} : Texel{ t[ 0 ], t[ 1 ], t[ 2 ], 255 };
+    case Encoding::eBC4:
+    case Encoding::eR8:
+        return Texel{ t[ 0 ], t[ 0 ], t[ 0 ], 255 };
+    case Encoding::eA8:
+        return Texel{ t[ 3 ], t[ 3 ], t[ 3 ], 255 };
+    case Encoding::eBC5:
+        return Texel{ t[ 0 ], t[ 1 ], 0, 255 };
+    default:
+        return t;
+    }
+}
+
+struct Verdict {
+    bool ok = false;
+    dds::Codec codec = dds::Codec::eNone;
+    double psnr = 0.0;
+};
+
+static Verdict verify( const std::vector<uint8_t>& file, const Variant& v, const Image& top )
+{
+    Verdict ret{};
+    dds::Layout layout{};
+    if ( !dds::parseLayout( { file.data(), file.size() }, file.size(), 0, 0, layout ) ) return ret;
+    if ( layout.oWidth != top.width || layout.oHeight != top.height ) return ret;
+
+    std::vector<uint32_t> argb( (size_t)layout.width * layout.height );
+    const dds::Span<const uint8_t> payload{ file.data() + layout.offset, file.size() - layout.offset };
+    if ( !dds::decode( layout, payload, argb.data(), layout.width * sizeof( uint32_t ) ) ) return ret;
+
+    double sum = 0.0;
+    for ( uint32_t y = 0; y < top.height; ++y ) {
+        for ( uint32_t x = 0; x < top.width; ++x ) {
+            const uint32_t p = argb[ (size_t)y * layout.width + x ];
+            const Texel decoded{ (uint8_t)( p >> 16 ), (uint8_t)( p >> 8 ), (uint8_t)p, (uint8_t)( p >> 24 ) };
+            sum += bcenc::distance( decoded, reference( v.encoding, top.at( x, y ) ), 0, 4 );
+        }
+    }
+    const double mse = sum / ( 4.0 * top.width * top.height );
+    ret.ok = true;
+    ret.codec = layout.codec;
+    ret.psnr = mse > 0.0 ? std::min( 10.0 * std::log10( 255.0 * 255.0 / mse ), 99.0 ) : 99.0;
+    return ret;
+}
+
+static std::vector<Variant> variants( uint32_t s )
+{
+    const uint32_t h = s / 2;
+    const uint32_t q = s / 4;
+    using E = Encoding;
+    using C = Content;
+    using K = Container;
+    return {
+        // legacy fourCC
+        { "dxt1-mips", E::eBC1, C::eColor, K::eFourCC, '1TXD', s, s, true },
+        { "dxt1-cutout-odd", E::eBC1A, C::eCutout, K::eFourCC, '1TXD', h + 3, q + 1 },
+        { "dxt3", E::eBC2, C::eAlpha, K::eFourCC, '3TXD', s, h },
+        { "dxt5-mips", E::eBC3, C::eAlpha, K::eFourCC, '5TXD', s, s, true },
+        { "ati1", E::eBC4, C::eGray, K::eFourCC, '1ITA', h, h },
+        { "bc4u-odd", E::eBC4, C::eGray, K::eFourCC, 'U4CB', 37, 23 },
+        { "ati2-normal-mips", E::eBC5, C::eNormal, K::eFourCC, '2ITA', s, s, true },
+        { "bc5u-normal", E::eBC5, C::eNormal, K::eFourCC, 'U5CB', h, s },
+        { "dxt1-cubemap", E::eBC1, C::eColor, K::eFourCC, '1TXD', q, q, true, 1, 1, true },
+        { "dxt5-volume", E::eBC3, C::eAlpha, K::eFourCC, '5TXD', q, q, true, 4 },
+
+        // legacy uncompressed, lookup table and deswizzle paths
+        { "a8r8g8b8-mips", E::eB8G8R8A8, C::eAlpha, K::eRGB, 0, h, h, true, 1, 1, false, 1 },
+        { "x8r8g8b8", E::eB8G8R8X8, C::eColor, K::eRGB, 0, h, h, false, 1, 1, false, 1 },
+        { "a8b8g8r8", E::eR8G8B8A8, C::eAlpha, K::eRGB, 0, h, h },
+        { "r8g8b8-pitched-odd", E::eB8G8R8, C::eColor, K::eRGB, 0, q + 1, q + 3, false, 1, 1, false, 4 },
+        { "r5g6b5", E::eB5G6R5, C::eColor, K::eRGB, 0, h, h, false, 1, 1, false, 1 },
+        { "a1r5g5b5", E::eB5G5R5A1, C::eCutout, K::eRGB, 0, h, h, false, 1, 1, false, 1 },
+        { "a4r4g4b4", E::eB4G4R4A4, C::eAlpha, K::eRGB, 0, h, h, false, 1, 1, false, 1 },
+        { "l8-pitched", E::eR8, C::eGray, K::eRGB, 0, q + 5, q, false, 1, 1, false, 64 },
+        { "a8", E::eA8, C::eAlpha, K::eRGB, 0, h, h },
+        { "a8r8g8b8-volume", E::eB8G8R8A8, C::eAlpha, K::eRGB, 0, q, q, true, 8 },
+
+        // DX10
+        { "bc1-unorm", E::eBC1, C::eColor, K::eDX10, DXGI_FORMAT_BC1_UNORM, s, s },
+        { "bc1-srgb-odd", E::eBC1, C::eColor, K::eDX10, DXGI_FORMAT_BC1_UNORM_SRGB, h + 1, h + 3 },
+        { "bc1-3x5", E::eBC1, C::eColor, K::eDX10, DXGI_FORMAT_BC1_UNORM, 3, 5 },
+        { "bc2-unorm", E::eBC2, C::eAlpha, K::eDX10, DXGI_FORMAT_BC2_UNORM, h, h },
+        { "bc3-srgb", E::eBC3, C::eAlpha, K::eDX10, DXGI_FORMAT_BC3_UNORM_SRGB, h, h },
+        { "bc4-unorm", E::eBC4, C::eGray, K::eDX10, DXGI_FORMAT_BC4_UNORM, h, h },
+        { "bc5-unorm-mips", E::eBC5, C::eNormal, K::eDX10, DXGI_FORMAT_BC5_UNORM, h, h, true },
+        { "bc7-unorm-mips", E::eBC7, C::eColor, K::eDX10, DXGI_FORMAT_BC7_UNORM, s, s, true },
+        { "bc7-srgb-alpha", E::eBC7, C::eAlpha, K::eDX10, DXGI_FORMAT_BC7_UNORM_SRGB, s, s },
+        { "bc7-typeless-odd", E::eBC7, C::eColor, K::eDX10, DXGI_FORMAT_BC7_TYPELESS, h + 3, q + 1 },
+        { "bc7-normal", E::eBC7, C::eNormal, K::eDX10, DXGI_FORMAT_BC7_UNORM, h, h },
+        { "bc7-array", E::eBC7, C::eColor, K::eDX10, DXGI_FORMAT_BC7_UNORM, h, h, true, 1, 4 },
+        { "bc7-volume", E::eBC7, C::eAlpha, K::eDX10, DXGI_FORMAT_BC7_UNORM, q, q, true, 4 },
+        { "bc7-1x1", E::eBC7, C::eColor, K::eDX10, DXGI_FORMAT_BC7_UNORM, 1, 1 },
+        { "b8g8r8a8", E::eB8G8R8A8, C::eAlpha, K::eDX10, DXGI_FORMAT_B8G8R8A8_UNORM, h, h },
+        { "b5g6r5", E::eB5G6R5, C::eColor, K::eDX10, DXGI_FORMAT_B5G6R5_UNORM, h, h },
+        { "b5g5r5a1", E::eB5G5R5A1, C::eCutout, K::eDX10, DXGI_FORMAT_B5G5R5A1_UNORM, h, h },
+        { "b4g4r4a4", E::eB4G4R4A4, C::eAlpha, K::eDX10, DXGI_FORMAT_B4G4R4A4_UNORM, h, h },
+        { "r8-odd", E::eR8, C::eGray, K::eDX10, DXGI_FORMAT_R8_UNORM, q + 3, q + 1 },
+
+        // Xbox One, linear aligned and 1D tiled
+        { "xbox-bc1-thin", E::eBC1, C::eColor, K::eXbox, DXGI_FORMAT_BC1_UNORM, s, h, false, 1, 1, false, 0, XBOXHeader::eThin1D },
+        { "xbox-bc3-linear-odd", E::eBC3, C::eAlpha, K::eXbox, DXGI_FORMAT_BC3_UNORM, h + 3, q + 1, false, 1, 1, false, 0, XBOXHeader::eLinear },
+        { "xbox-bc7-thin-odd", E::eBC7, C::eColor, K::eXbox, DXGI_FORMAT_BC7_UNORM, h + 3, q + 1, false, 1, 1, false, 0, XBOXHeader::eThin1D },
+        { "xbox-bc7-display", E::eBC7, C::eAlpha, K::eXbox, DXGI_FORMAT_BC7_UNORM, h, h, false, 1, 1, false, 0, XBOXHeader::eDisplay1D },
+        { "xbox-bc4-display", E::eBC4, C::eGray, K::eXbox, DXGI_FORMAT_BC4_UNORM, h, q, false, 1, 1, false, 0, XBOXHeader::eDisplay1D },
+        { "xbox-b8g8r8a8-display", E::eB8G8R8A8, C::eAlpha, K::eXbox, DXGI_FORMAT_B8G8R8A8_UNORM, q + 5, q + 3, false, 1, 1, false, 0, XBOXHeader::eDisplay1D },
+        { "xbox-b5g6r5-display", E::eB5G6R5, C::eColor, K::eXbox, DXGI_FORMAT_B5G6R5_UNORM, h, q, false, 1, 1, false, 0, XBOXHeader::eDisplay1D },
+        { "xbox-r8-thin-odd", E::eR8, C::eGray, K::eXbox, DXGI_FORMAT_R8_UNORM, q + 3, q + 1, false, 1, 1, false, 0, XBOXHeader::eThin1D },
+    };
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    uint32_t seed = 1;
+    uint32_t size = 512;
+    const char* output = nullptr;
+    for ( int i = 1; i < argc; ++i ) {
+        if ( !std::strcmp( argv[ i ], "--seed" ) && i + 1 < argc ) {
+            seed = static_cast<uint32_t>( std::strtoul( argv[ ++i ], nullptr, 10 ) );
+        }
+        else if ( !std::strcmp( argv[ i ], "--size" ) && i + 1 < argc ) {
+            size = static_cast<uint32_t>( std::strtoul( argv[ ++i ], nullptr, 10 ) );
+        }
+        else if ( argv[ i ][ 0 ] != '-' && !output ) {
+            output = argv[ i ];
+        }
+        else {
+            output = nullptr;
+            break;
+        }
+    }
+    if ( !output || size < 16 ) {
+        std::fprintf( stderr, "usage: %s [--seed N] [--size N, at least 16] output-directory\n", argv[ 0 ] );
+        return 1;
+    }
+
+    std::error_code error{};
+    std::filesystem::create_directories( output, error );
+    if ( error ) {
+        std::fprintf( stderr, "cannot create %s: %s\n", output, error.message().c_str() );
+        return 1;
+    }
+
+    bcenc::BC7Stats stats{};
+    int failures = 0;
+    const std::vector<Variant> list = variants( size );
+    for ( size_t i = 0; i < list.size(); ++i ) {
+        const Variant& v = list[ i ];
+        Image top{};
+        const std::vector<uint8_t> file = makeFile( v, seed * 7919u + static_cast<uint32_t>( i ) * 104729u, top, stats );
+        const std::filesystem::path path = std::filesystem::path{ output } / ( v.name + ".dds" );
+        std::ofstream stream{ path, std::ios::binary };
+        stream.write( reinterpret_cast<const char*>( file.data() ), static_cast<std::streamsize>( file.size() ) );
+        stream.close();
+        if ( !stream ) {
+            std::fprintf( stderr, "cannot write %s\n", path.c_str() );
+            return 1;
+        }
+
+        std::ifstream readBack{ path, std::ios::binary };
+        const std::vector<uint8_t> written{ std::istreambuf_iterator<char>{ readBack }, std::istreambuf_iterator<char>{} };
+        const Verdict verdict = verify( written, v, top );
+        failures += !verdict.ok;
+        std::printf( "%-22s %-10s %5ux%-5u %10zu bytes  %s\n"
+            , v.name.c_str()
+            , verdict.ok ? dds::name( verdict.codec ) : "-"
+            , v.width
+            , v.height
+            , file.size()
+            , verdict.ok ? ( std::to_string( verdict.psnr ).substr( 0, 5 ) + " dB" ).c_str() : "FAILED" );
+    }
+
+    uint64_t blocks = 0;
+    for ( uint64_t n : stats.modes ) blocks += n;
+    if ( blocks ) {
+        std::printf( "\nBC7 blocks %llu, modes:", static_cast<unsigned long long>( blocks ) );
+        for ( uint32_t m = 0; m < 8; ++m ) std::printf( " %u:%.1f%%", m, 100.0 * stats.modes[ m ] / blocks );
+        const auto used = std::count_if( std::begin( stats.partitions ), std::end( stats.partitions ), []( uint64_t n ) { return n != 0; } );
+        std::printf( ", partitions used %lld/64\n", static_cast<long long>( used ) );
+    }
+    return failures ? 1 : 0;
+}
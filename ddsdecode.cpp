@@ -0,0 +1,1381 @@
+// MIT License
+//
+// Copyright (c) 2022 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Format references
+// https://docs.microsoft.com/en-us/windows/uwp/graphics-concepts/opaque-and-1-bit-alpha-textures
+// https://docs.microsoft.com/en-us/windows/win32/direct3d10/d3d10-graphics-programming-guide-resources-block-compression
+// https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+// https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-pixelformat
+// https://github.com/Microsoft/DirectXTK/wiki/DDSTextureLoader
+// https://learn.microsoft.com/en-us/windows/win32/api/dxgiformat/ne-dxgiformat-dxgi_format
+// https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dformat
+// https://github.com/GPUOpen-Drivers/pal/tree/dev/src/core/imported/addrlib ( micro tile element order and alignments )
+
+#include "ddsdecode.hpp"
+#include "ddsformat.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#if defined( __BMI2__ )
+#include <immintrin.h>
+#endif
+
+#ifndef NDEBUG
+#include <iostream>
+#define LOG( msg ) std::cerr << ( msg ) << "\n";
+#else
+#define LOG( msg ) {}
+#endif
+
+namespace {
+
+using dds::Codec;
+using dds::Colorspace;
+using dds::DDSHeader;
+using dds::DXGIHeader;
+using dds::Layout;
+using dds::PixelFormat;
+using dds::Tiling;
+using dds::XBOXHeader;
+using namespace dds; // DXGI_FORMAT_* enumerators
+
+struct Byte3 {
+    uint8_t channel[ 3 ];
+    operator uint32_t () const
+    {
+        uint32_t ret = 0;
+        ret |= channel[ 2 ]; ret <<= 8;
+        ret |= channel[ 1 ]; ret <<= 8;
+        ret |= channel[ 0 ];
+        return ret;
+    }
+};
+
+namespace colorfn {
+
+static uint32_t makeARGB8888( uint32_t r, uint32_t g, uint32_t b, uint32_t a )
+{
+    return ( a << 24 ) | ( r << 16 ) | ( g << 8 ) | b;
+}
+
+static uint32_t b4g4r4a4( uint16_t c )
+{
+    uint32_t a = ( c >> 12 ) & 0xF;
+    uint32_t r = ( c >> 8 ) & 0xF;
+    uint32_t g = ( c >> 4 ) & 0xF;
+    uint32_t b = c & 0xF;
+    a |= a << 4;
+    r |= r << 4;
+    g |= g << 4;
+    b |= b << 4;
+    return makeARGB8888( r, g, b, a );
+}
+
+static uint32_t b8g8r8( Byte3 c )
+{
+    return makeARGB8888( c.channel[ 2 ], c.channel[ 1 ], c.channel[ 0 ], 0xFF );
+}
+
+static uint32_t b5g5r5a1( uint16_t c )
+{
+    uint32_t a = ( c >> 15 ) ? 0xFF : 0;
+    uint32_t r = ( c >> 10 ) & 0b11111;
+    uint32_t g = ( c >> 5 ) & 0b11111;
+    uint32_t b = c & 0b11111;
+
+    r = ( r << 3 ) | ( r >> 2 );
+    g = ( g << 3 ) | ( g >> 2 );
+    b = ( b << 3 ) | ( b >> 2 );
+    return makeARGB8888( r, g, b, a );
+}
+
+static uint32_t b5g6r5( uint16_t c )
+{
+    uint32_t r = c >> 11;
+    uint32_t g = ( c >> 5 ) & 0b111111;
+    uint32_t b = c & 0b11111;
+
+    r = ( r << 3 ) | ( r >> 2 );
+    g = ( g << 2 ) | ( g >> 4 );
+    b = ( b << 3 ) | ( b >> 2 );
+    return makeARGB8888( r, g, b, 0xFF );
+}
+
+static uint32_t r8( uint8_t c )
+{
+    return makeARGB8888( c, c, c, 0xFF );
+}
+
+}
+
+template <size_t TWeight>
+inline uint8_t lerp( uint16_t e0, uint16_t e1 )
+{
+    static_assert( TWeight <= 64 );
+    return static_cast<uint8_t>( ( ( 64 - TWeight ) * e0 + TWeight * e1 + 32 ) >> 6 );
+}
+
+template <size_t TWeight>
+inline uint16_t lerp565( uint16_t lhs, uint16_t rhs )
+{
+    static constexpr uint16_t MASK_R5G6B5_R = 0b1111100000000000;
+    static constexpr uint16_t MASK_R5G6B5_G = 0b0000011111100000;
+    static constexpr uint16_t MASK_R5G6B5_B = 0b0000000000011111;
+
+    const uint16_t r0 = ( lhs & MASK_R5G6B5_R ) >> 11;
+    const uint16_t r1 = ( rhs & MASK_R5G6B5_R ) >> 11;
+    const uint16_t g0 = ( lhs & MASK_R5G6B5_G ) >> 5;
+    const uint16_t g1 = ( rhs & MASK_R5G6B5_G ) >> 5;
+    const uint16_t b0 = ( lhs & MASK_R5G6B5_B );
+    const uint16_t b1 = ( rhs & MASK_R5G6B5_B );
+    const uint16_t r = lerp<TWeight>( r0, r1 );
+    const uint16_t g = lerp<TWeight>( g0, g1 );
+    const uint16_t b = lerp<TWeight>( b0, b1 );
+    return ( ( r << 11 ) & MASK_R5G6B5_R )
+        | ( ( g << 5 ) & MASK_R5G6B5_G )
+        | ( b & MASK_R5G6B5_B );
+}
+
+// NOTE: all 16 2-bit indices equal
+constexpr inline bool hasUniform2bitIndices( uint32_t indexes )
+{
+    return indexes == ( indexes & 0b11u ) * 0x55555555u;
+}
+static_assert( hasUniform2bitIndices( 0xAAAAAAAAu ) );
+static_assert( !hasUniform2bitIndices( 0xAAAAAAA8u ) );
+
+// NOTE: all 16 3-bit indices equal
+constexpr inline bool hasUniform3bitIndices( uint64_t indexes )
+{
+    return indexes == ( indexes & 0b111u ) * 0x249249249249ull;
+}
+static_assert( hasUniform3bitIndices( 0xDB6DB6DB6DB6ull ) );
+static_assert( !hasUniform3bitIndices( 0xDB6DB6DB6DB7ull ) );
+
+struct BC1 {
+    uint16_t color0;
+    uint16_t color1;
+    uint32_t indexes;
+
+    static constexpr const char* NAME = "BC1";
+
+    // NOTE: with equal endpoints only index 3 of 3-color mode ( transparent black ) differs
+    bool isUniform() const
+    {
+        if ( color0 == color1 ) {
+            return !( indexes & ( indexes >> 1 ) & 0x55555555u );
+        }
+        return hasUniform2bitIndices( indexes );
+    }
+
+    uint32_t operator [] ( uint32_t i ) const
+    {
+        assert( i < 16 );
+        const uint32_t index = 0b11 & ( indexes >> ( i * 2 ) );
+        switch ( index ) {
+        case 0: return colorfn::b5g6r5( color0 );
+        case 1: return colorfn::b5g6r5( color1 );
+        case 2: return color0 <= color1
+            ? colorfn::b5g6r5( lerp565<32>( color0, color1 ) )
+            : colorfn::b5g6r5( lerp565<21>( color0, color1 ) );
+        case 3: return color0 <= color1
+            ? 0u
+            : colorfn::b5g6r5( lerp565<43>( color0, color1 ) );
+        default: return 0;
+        }
+    }
+
+    // NOTE: 3-color mode is resolved once per block, texels only look up the palette
+    void decodeTile( uint32_t* tile ) const
+    {
+        uint32_t palette[ 4 ]{ colorfn::b5g6r5( color0 ), colorfn::b5g6r5( color1 ) };
+        if ( color0 <= color1 ) {
+            palette[ 2 ] = colorfn::b5g6r5( lerp565<32>( color0, color1 ) );
+            palette[ 3 ] = 0u;
+        }
+        else {
+            palette[ 2 ] = colorfn::b5g6r5( lerp565<21>( color0, color1 ) );
+            palette[ 3 ] = colorfn::b5g6r5( lerp565<43>( color0, color1 ) );
+        }
+        for ( uint32_t i = 0; i < 16; ++i ) {
+            tile[ i ] = palette[ 0b11 & ( indexes >> ( i * 2 ) ) ];
+        }
+    }
+};
+static_assert( sizeof( BC1 ) == 8, "sizeof BC1 not equal 8" );
+
+struct BC2 {
+    uint16_t alphas[ 4 ];
+    uint16_t color0;
+    uint16_t color1;
+    uint32_t indexes;
+
+    static constexpr const char* NAME = "BC2";
+
+    bool isUniform() const
+    {
+        const uint16_t a = ( alphas[ 0 ] & 0xF ) * 0x1111;
+        const bool uniformAlpha = alphas[ 0 ] == a && alphas[ 1 ] == a && alphas[ 2 ] == a && alphas[ 3 ] == a;
+        return uniformAlpha && hasUniform2bitIndices( indexes );
+    }
+
+    uint32_t operator [] ( uint32_t i ) const
+    {
+        assert( i < 16 );
+        const uint32_t index = 0b11 & ( indexes >> ( i * 2 ) );
+        return alpha( i ) | colorFromIndex( index );
+    }
+
+    uint32_t alpha( uint32_t i ) const
+    {
+        uint32_t a = alphas[ i / 4 ];
+        uint32_t alph = ( a >> ( i % 4 ) * 4 ) & 0xF;
+        return ( alph << 28 ) | ( alph << 24 );
+    }
+
+    uint32_t colorFromIndex( uint32_t i ) const
+    {
+        const uint32_t removeAlpha = 0x00FFFFFF;
+        switch ( i ) {
+        case 0: return colorfn::b5g6r5( color0 ) & removeAlpha;
+        case 1: return colorfn::b5g6r5( color1 ) & removeAlpha;
+        case 2: return colorfn::b5g6r5( lerp565<21>( color0, color1 ) ) & removeAlpha;
+        case 3: return colorfn::b5g6r5( lerp565<43>( color0, color1 ) ) & removeAlpha;
+        default: return 0;
+        }
+    }
+
+    void decodeTile( uint32_t* tile ) const
+    {
+        const uint32_t palette[ 4 ]{ colorFromIndex( 0 ), colorFromIndex( 1 ), colorFromIndex( 2 ), colorFromIndex( 3 ) };
+        for ( uint32_t i = 0; i < 16; ++i ) {
+            tile[ i ] = alpha( i ) | palette[ 0b11 & ( indexes >> ( i * 2 ) ) ];
+        }
+    }
+};
+static_assert( sizeof( BC2 ) == 16, "sizeof BC2 not equal 16" );
+
+struct BC4 {
+    uint64_t alpha0 : 8;
+    uint64_t alpha1 : 8;
+    uint64_t aindexes : 48;
+
+    static constexpr const char* NAME = "BC4";
+
+    // NOTE: with equal endpoints only indices 6 and 7 ( constant 0 and 255 ) differ
+    bool isUniform() const
+    {
+        const uint64_t i = aindexes;
+        if ( alpha0 == alpha1 ) {
+            return !( ( i >> 2 ) & ( i >> 1 ) & 0x249249249249ull );
+        }
+        return hasUniform3bitIndices( i );
+    }
+
+    uint8_t alphaIndice( uint32_t i ) const
+    {
+        return ( aindexes >> ( i * 3 ) ) & 0b111;
+    }
+
+    uint32_t alpha( uint32_t i ) const
+    {
+        const bool b = alpha0 > alpha1;
+        switch ( alphaIndice( i ) ) {
+        case 0b000: return alpha0;
+        case 0b001: return alpha1;
+        case 0b010: return b ? lerp<9>( alpha0, alpha1 ) : lerp<13>( alpha0, alpha1 );
+        case 0b011: return b ? lerp<18>( alpha0, alpha1 ) : lerp<26>( alpha0, alpha1 );
+        case 0b100: return b ? lerp<27>( alpha0, alpha1 ) : lerp<38>( alpha0, alpha1 );
+        case 0b101: return b ? lerp<37>( alpha0, alpha1 ) : lerp<51>( alpha0, alpha1 );
+        case 0b110: return b ? lerp<46>( alpha0, alpha1 ) : 0u;
+        case 0b111: return b ? lerp<55>( alpha0, alpha1 ) : 255u;
+        default: return 0;
+        }
+    }
+
+    // NOTE: all 8 values of the block, 6 or 8 value mode resolved once instead of per texel
+    void alphaPalette( uint8_t* palette ) const
+    {
+        palette[ 0 ] = alpha0;
+        palette[ 1 ] = alpha1;
+        if ( alpha0 > alpha1 ) {
+            palette[ 2 ] = lerp<9>( alpha0, alpha1 );
+            palette[ 3 ] = lerp<18>( alpha0, alpha1 );
+            palette[ 4 ] = lerp<27>( alpha0, alpha1 );
+            palette[ 5 ] = lerp<37>( alpha0, alpha1 );
+            palette[ 6 ] = lerp<46>( alpha0, alpha1 );
+            palette[ 7 ] = lerp<55>( alpha0, alpha1 );
+        }
+        else {
+            palette[ 2 ] = lerp<13>( alpha0, alpha1 );
+            palette[ 3 ] = lerp<26>( alpha0, alpha1 );
+            palette[ 4 ] = lerp<38>( alpha0, alpha1 );
+            palette[ 5 ] = lerp<51>( alpha0, alpha1 );
+            palette[ 6 ] = 0u;
+            palette[ 7 ] = 255u;
+        }
+    }
+
+    uint32_t operator [] ( uint32_t i ) const
+    {
+        return colorfn::r8( alpha( i ) );
+    }
+
+    void decodeTile( uint32_t* tile ) const
+    {
+        uint8_t palette[ 8 ];
+        alphaPalette( palette );
+        for ( uint32_t i = 0; i < 16; ++i ) {
+            tile[ i ] = colorfn::r8( palette[ alphaIndice( i ) ] );
+        }
+    }
+};
+static_assert( sizeof( BC4 ) == 8, "sizeof BC4 not equal 8" );
+
+struct BC3 : public BC4 {
+    uint16_t color0;
+    uint16_t color1;
+    uint32_t indexes;
+
+    static constexpr const char* NAME = "BC3";
+
+    bool isUniform() const
+    {
+        return BC4::isUniform() && ( color0 == color1 || hasUniform2bitIndices( indexes ) );
+    }
+
+    uint32_t operator [] ( uint32_t i ) const
+    {
+        assert( i < 16 );
+        const uint32_t index = 0b11 & ( indexes >> ( i * 2 ) );
+        return ( alpha( i ) << 24 ) | colorFromIndex( index );
+    }
+
+    uint32_t colorFromIndex( uint32_t i ) const
+    {
+        const uint32_t removeAlpha = 0x00FFFFFF;
+        switch ( i ) {
+        case 0: return colorfn::b5g6r5( color0 ) & removeAlpha;
+        case 1: return colorfn::b5g6r5( color1 ) & removeAlpha;
+        case 2: return colorfn::b5g6r5( lerp565<21>( color0, color1) ) & removeAlpha;
+        case 3: return colorfn::b5g6r5( lerp565<43>( color0, color1 ) ) & removeAlpha;
+        default: return 0;
+        }
+    }
+
+    void decodeTile( uint32_t* tile ) const
+    {
+        uint8_t alphas[ 8 ];
+        alphaPalette( alphas );
+        const uint32_t palette[ 4 ]{ colorFromIndex( 0 ), colorFromIndex( 1 ), colorFromIndex( 2 ), colorFromIndex( 3 ) };
+        for ( uint32_t i = 0; i < 16; ++i ) {
+            tile[ i ] = ( (uint32_t)alphas[ alphaIndice( i ) ] << 24 ) | palette[ 0b11 & ( indexes >> ( i * 2 ) ) ];
+        }
+    }
+};
+static_assert( sizeof( BC3 ) == 16, "sizeof BC3 not equal 16" );
+
+struct BC5 {
+    BC4 red;
+    BC4 green;
+
+    static constexpr const char* NAME = "BC5";
+
+    bool isUniform() const
+    {
+        return red.isUniform() && green.isUniform();
+    }
+
+    uint32_t operator [] ( uint32_t i ) const
+    {
+        assert( i < 16 );
+        return colorfn::makeARGB8888( red.alpha( i ), green.alpha( i ), 0u, 0xFFu );
+    }
+
+    void decodeTile( uint32_t* tile ) const
+    {
+        uint8_t reds[ 8 ];
+        uint8_t greens[ 8 ];
+        red.alphaPalette( reds );
+        green.alphaPalette( greens );
+        for ( uint32_t i = 0; i < 16; ++i ) {
+            tile[ i ] = colorfn::makeARGB8888( reds[ red.alphaIndice( i ) ], greens[ green.alphaIndice( i ) ], 0u, 0xFFu );
+        }
+    }
+};
+static_assert( sizeof( BC5 ) == 16, "sizeof BC5 not equal 16" );
+
+}
+
+#include "bc7.hpp"
+
+namespace {
+
+struct Deswizzler {
+    uint32_t rPopcount = 0;
+    uint32_t gPopcount = 0;
+    uint32_t bPopcount = 0;
+    uint32_t aPopcount = 0;
+    uint32_t rMask = 0;
+    uint32_t gMask = 0;
+    uint32_t bMask = 0;
+    uint32_t aMask = 0;
+    uint8_t rShift = 0;
+    uint8_t gShift = 0;
+    uint8_t bShift = 0;
+    uint8_t aShift = 0;
+
+    Deswizzler() = default;
+    Deswizzler( uint32_t rm, uint32_t gm, uint32_t bm, uint32_t am )
+    : rMask( rm )
+    , gMask( gm )
+    , bMask( bm )
+    , aMask( am )
+    {
+        rPopcount = __builtin_popcount( rm );
+        gPopcount = __builtin_popcount( gm );
+        bPopcount = __builtin_popcount( bm );
+        aPopcount = am ? __builtin_popcount( am ) : 255; // NOTE: if alpha mask is 0, make it opaque instead
+        rShift = rm ? __builtin_ctz( rm ) : 0;
+        gShift = gm ? __builtin_ctz( gm ) : 0;
+        bShift = bm ? __builtin_ctz( bm ) : 0;
+        aShift = am ? __builtin_ctz( am ) : 0;
+    }
+
+    static uint8_t rescale( uint32_t popcount, uint32_t c )
+    {
+        switch ( popcount ) {
+        default:
+        case 0: return 0;
+        case 1: return c ? 255 : 0;
+        case 4: return static_cast<uint8_t>( ( c << 4 ) | c );
+        case 5: return static_cast<uint8_t>( ( c << 3 ) | ( c >> 2 ) );
+        case 6: return static_cast<uint8_t>( ( c << 2 ) | ( c >> 4 ) );
+        [[likely]]
+        case 8: return static_cast<uint8_t>( c );
+        case 16: return static_cast<uint8_t>( c >> 8 );
+        case 24: return static_cast<uint8_t>( c >> 16 );
+        case 32: return static_cast<uint8_t>( c >> 24 );
+        [[likely]]
+        case 255: return 255;
+        }
+    }
+
+    uint32_t operator () ( uint32_t v ) const
+    {
+        uint8_t r = rescale( rPopcount, ( v & rMask ) >> rShift );
+        uint8_t g = rescale( gPopcount, ( v & gMask ) >> gShift );
+        uint8_t b = rescale( bPopcount, ( v & bMask ) >> bShift );
+        uint8_t a = rescale( aPopcount, ( v & aMask ) >> aShift );
+        return colorfn::makeARGB8888( r, g, b, a );
+    }
+
+    uint32_t operator () ( Byte3 v ) const
+    {
+        return operator ()( static_cast<uint32_t>( v ) );
+    }
+
+    uint32_t operator () ( uint16_t c ) const
+    {
+        return operator ()( static_cast<uint32_t>( c ) );
+    }
+
+    uint32_t operator () ( uint8_t c ) const
+    {
+        return operator ()( static_cast<uint32_t>( c ) );
+    }
+};
+
+// NOTE: walks block rows collapsing runs of identical blocks,
+//       uniform runs are filled per texel row in one go, others are decoded once and copied
+template <typename TBlockType>
+static dds::DecodeStats decompressBlocks( const TBlockType* blocks, uint64_t rows, uint32_t width, uint32_t* pixels, size_t stride )
+{
+    assert( width % 4 == 0 );
+    assert( blocks );
+    assert( pixels );
+    dds::DecodeStats stats{};
+    const uint32_t pitch = width / 4;
+    std::array<uint32_t, 16> tile{};
+    for ( uint64_t y = 0; y < rows; ++y ) {
+        const TBlockType* row = blocks + y * pitch;
+        uint32_t* dst = pixels + y * 4 * stride;
+        for ( uint32_t x = 0; x < pitch; ) {
+            const TBlockType& block = row[ x ];
+            uint32_t run = 1;
+            while ( x + run < pitch && std::memcmp( &row[ x + run ], &block, sizeof( TBlockType ) ) == 0 ) {
+                run++;
+            }
+            stats.blocks += run;
+            stats.repeated += run - 1;
+            if constexpr ( std::is_same_v<TBlockType, BC7> ) {
+                const uint8_t mode = block.raw[ 0 ];
+                if ( mode ) stats.bc7Modes[ __builtin_ctz( mode ) ] += run;
+            }
+
+            uint32_t* tileDst = dst + x * 4;
+            if ( block.isUniform() ) {
+                stats.uniform += run;
+                const uint32_t color = block[ 0 ];
+                for ( uint32_t i = 0; i < 4; ++i ) {
+                    std::fill_n( tileDst + i * stride, run * 4, color );
+                }
+            }
+            else {
+                block.decodeTile( tile.data() );
+                for ( uint32_t r = 0; r < run; ++r ) {
+                    for ( uint32_t i = 0; i < 4; ++i ) {
+                        std::copy_n( tile.data() + i * 4, 4, tileDst + r * 4 + i * stride );
+                    }
+                }
+            }
+            x += run;
+        }
+    }
+    return stats;
+}
+
+// NOTE: element index within a micro tile has the bits of x and y within the tile scattered over it,
+//       masks tell where, lowest coordinate bit going to the lowest mask bit
+struct TileSwizzle {
+    uint32_t xMask = 0;
+    uint32_t yMask = 0;
+};
+
+static TileSwizzle tileSwizzle( Tiling tiling, uint32_t elementBytes )
+{
+    if ( tiling == Tiling::eThin ) return TileSwizzle{ 0b010101, 0b101010 };
+    switch ( elementBytes ) {
+    case 2: return TileSwizzle{ 0b000111, 0b111000 }; // x0 x1 x2 y0 y1 y2
+    case 4: return TileSwizzle{ 0b001011, 0b110100 }; // x0 x1 y0 x2 y1 y2
+    case 8: return TileSwizzle{ 0b001101, 0b110010 }; // x0 y0 x1 x2 y1 y2
+    case 16: return TileSwizzle{ 0b001110, 0b110001 }; // y0 x0 x1 x2 y1 y2
+    default: return {};
+    }
+}
+
+// NOTE: PDEP with -DDDS_BMI2=ON, the loop deposits the same bits elsewhere
+static inline uint32_t depositBits( uint32_t value, uint32_t mask )
+{
+#if defined( __BMI2__ )
+    return _pdep_u32( value, mask );
+#else
+    uint32_t ret = 0;
+    for ( uint32_t bit = 1; mask; bit <<= 1, mask &= mask - 1 ) {
+        if ( value & bit ) ret |= mask & ( ~mask + 1 );
+    }
+    return ret;
+#endif
+}
+
+// NOTE: element indices of one element row of a micro tile, left to right
+static std::array<uint8_t, 8> microTileRow( const TileSwizzle& swizzle, uint32_t y )
+{
+    std::array<uint8_t, 8> ret{};
+    const uint32_t row = depositBits( y, swizzle.yMask );
+    for ( uint32_t x = 0; x < 8; ++x ) {
+        ret[ x ] = static_cast<uint8_t>( row | depositBits( x, swizzle.xMask ) );
+    }
+    return ret;
+}
+
+// NOTE: detiles while decoding, output rows are written in order and tiles read out of order,
+//       no linear copy of the stored rows is made
+template <typename TBlockType>
+static dds::DecodeStats decompressTiledBlocks( const uint8_t* rows, uint64_t count, uint64_t pitch, uint32_t width, const TileSwizzle& swizzle, uint32_t* pixels, size_t stride )
+{
+    assert( width % 32 == 0 );
+    dds::DecodeStats stats{};
+    const uint32_t tiles = width / 32;
+    std::array<uint32_t, 16> texels{};
+    for ( uint64_t row = 0; row < count; ++row ) {
+        const TBlockType* tileRow = reinterpret_cast<const TBlockType*>( rows + row * pitch );
+        for ( uint32_t y = 0; y < 8; ++y ) {
+            const std::array<uint8_t, 8> index = microTileRow( swizzle, y );
+            uint32_t* dst = pixels + ( row * 8 + y ) * 4 * stride;
+            for ( uint32_t t = 0; t < tiles; ++t ) {
+                const TBlockType* tile = tileRow + t * 64;
+                for ( uint32_t x = 0; x < 8; ++x ) {
+                    const TBlockType& block = tile[ index[ x ] ];
+                    uint32_t* blockDst = dst + ( t * 8 + x ) * 4;
+                    stats.blocks++;
+                    // NOTE: padding up to whole micro tiles is zeroed, BC7 has no valid block with empty mode field
+                    if constexpr ( std::is_same_v<TBlockType, BC7> ) {
+                        const uint8_t mode = block.raw[ 0 ];
+                        if ( !mode ) {
+                            for ( uint32_t i = 0; i < 4; ++i ) {
+                                std::fill_n( blockDst + i * stride, 4, 0u );
+                            }
+                            continue;
+                        }
+                        stats.bc7Modes[ __builtin_ctz( mode ) ]++;
+                    }
+                    if ( block.isUniform() ) {
+                        stats.uniform++;
+                        const uint32_t color = block[ 0 ];
+                        for ( uint32_t i = 0; i < 4; ++i ) {
+                            std::fill_n( blockDst + i * stride, 4, color );
+                        }
+                        continue;
+                    }
+                    block.decodeTile( texels.data() );
+                    for ( uint32_t i = 0; i < 4; ++i ) {
+                        std::copy_n( texels.data() + i * 4, 4, blockDst + i * stride );
+                    }
+                }
+            }
+        }
+    }
+    return stats;
+}
+
+template <typename TSrc, typename TFn>
+static void convertTiledRows( const uint8_t* rows, uint64_t count, uint64_t pitch, uint32_t width, const TileSwizzle& swizzle, uint32_t* pixels, size_t stride, TFn&& fn )
+{
+    assert( width % 8 == 0 );
+    const uint32_t tiles = width / 8;
+    for ( uint64_t row = 0; row < count; ++row ) {
+        const TSrc* tileRow = reinterpret_cast<const TSrc*>( rows + row * pitch );
+        for ( uint32_t y = 0; y < 8; ++y ) {
+            const std::array<uint8_t, 8> index = microTileRow( swizzle, y );
+            uint32_t* dst = pixels + ( row * 8 + y ) * stride;
+            for ( uint32_t t = 0; t < tiles; ++t ) {
+                const TSrc* tile = tileRow + t * 64;
+                for ( uint32_t x = 0; x < 8; ++x ) {
+                    dst[ t * 8 + x ] = fn( tile[ index[ x ] ] );
+                }
+            }
+        }
+    }
+}
+
+static bool decodeTiledRows( const Layout& layout, const uint8_t* src, uint64_t count, uint32_t* argb, size_t stride, dds::DecodeStats& stats )
+{
+    const uint32_t extent = layout.texelsPerRow / 8;
+    const uint64_t elementBytes = layout.rowPitch / ( (uint64_t)layout.width / extent * 8 );
+    const TileSwizzle swizzle = tileSwizzle( layout.tiling, static_cast<uint32_t>( elementBytes ) );
+    if ( !swizzle.xMask ) {
+        LOG( "Unsupported tiled element size, maybe TODO" );
+        return false;
+    }
+    auto copy = []( uint32_t c ) { return c; };
+    switch ( layout.codec ) {
+    case Codec::eBC1: stats = decompressTiledBlocks<BC1>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride ); break;
+    case Codec::eBC2: stats = decompressTiledBlocks<BC2>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride ); break;
+    case Codec::eBC3: stats = decompressTiledBlocks<BC3>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride ); break;
+    case Codec::eBC4: stats = decompressTiledBlocks<BC4>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride ); break;
+    case Codec::eBC5: stats = decompressTiledBlocks<BC5>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride ); break;
+    case Codec::eBC7: stats = decompressTiledBlocks<BC7>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride ); break;
+    case Codec::eB8G8R8A8: convertTiledRows<uint32_t>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride, copy ); break;
+    case Codec::eB5G6R5: convertTiledRows<uint16_t>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride, &colorfn::b5g6r5 ); break;
+    case Codec::eB5G5R5A1: convertTiledRows<uint16_t>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride, &colorfn::b5g5r5a1 ); break;
+    case Codec::eB4G4R4A4: convertTiledRows<uint16_t>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride, &colorfn::b4g4r4a4 ); break;
+    case Codec::eR8: convertTiledRows<uint8_t>( src, count, layout.rowPitch, layout.width, swizzle, argb, stride, &colorfn::r8 ); break;
+    default:
+        LOG( "Unsupported tiled format, maybe TODO" );
+        return false;
+    }
+    return true;
+}
+
+template <typename TSrc, typename TFn>
+static void convertRows( const uint8_t* rows, uint64_t count, uint64_t pitch, uint32_t width, uint32_t* pixels, size_t stride, TFn&& fn )
+{
+    for ( uint64_t y = 0; y < count; ++y ) {
+        const TSrc* src = reinterpret_cast<const TSrc*>( rows + y * pitch );
+        std::transform( src, src + width, pixels + y * stride, fn );
+    }
+}
+
+// NOTE: Happy endianness
+//       DXGI_FORMAT_B8G8R8A8_UNORM == QImage::Format_ARGB32
+static void copyRows( const uint8_t* rows, uint64_t count, uint64_t pitch, uint32_t width, uint32_t* pixels, size_t stride )
+{
+    for ( uint64_t y = 0; y < count; ++y ) {
+        std::memcpy( pixels + y * stride, rows + y * pitch, width * sizeof( uint32_t ) );
+    }
+}
+
+static void deswizzleRows( const Layout& layout, const uint8_t* rows, uint64_t count, uint32_t* pixels, size_t stride )
+{
+    const Deswizzler deswizzler{ layout.masks[ 0 ], layout.masks[ 1 ], layout.masks[ 2 ], layout.masks[ 3 ] };
+    switch ( layout.bytesPerPixel ) {
+    case 1: convertRows<uint8_t>( rows, count, layout.rowPitch, layout.width, pixels, stride, deswizzler ); break;
+    case 2: convertRows<uint16_t>( rows, count, layout.rowPitch, layout.width, pixels, stride, deswizzler ); break;
+    case 3: convertRows<Byte3>( rows, count, layout.rowPitch, layout.width, pixels, stride, deswizzler ); break;
+    case 4: convertRows<uint32_t>( rows, count, layout.rowPitch, layout.width, pixels, stride, deswizzler ); break;
+    default: assert( !"unreachable" ); break;
+    }
+}
+
+struct BlockInfo {
+    uint32_t extent = 0; // texels along block edge, 4 for block compressed, 1 for uncompressed
+    uint32_t bytes = 0;
+};
+
+static BlockInfo fourCCBlockInfo( uint32_t fourCC )
+{
+    switch ( fourCC ) {
+    case '1TXD': [[fallthrough]];
+    case 'U4CB': [[fallthrough]];
+    case 'S4CB': [[fallthrough]];
+    case '1ITA': return BlockInfo{ 4, 8 };
+    case '2TXD': [[fallthrough]];
+    case '3TXD': [[fallthrough]];
+    case '4TXD': [[fallthrough]];
+    case '5TXD': [[fallthrough]];
+    case 'U5CB': [[fallthrough]];
+    case 'S5CB': [[fallthrough]];
+    case '2ITA': return BlockInfo{ 4, 16 };
+    default: return {};
+    }
+}
+
+static BlockInfo dxgiBlockInfo( uint32_t format )
+{
+    switch ( format ) {
+    case DXGI_FORMAT_R8_UNORM: return BlockInfo{ 1, 1 };
+    case DXGI_FORMAT_B5G6R5_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_B5G5R5A1_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_B4G4R4A4_UNORM: return BlockInfo{ 1, 2 };
+    case DXGI_FORMAT_B8G8R8A8_UNORM: return BlockInfo{ 1, 4 };
+    case DXGI_FORMAT_BC1_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC1_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC1_UNORM_SRGB: [[fallthrough]];
+    case DXGI_FORMAT_BC4_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC4_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC4_UNORM_SRGB: return BlockInfo{ 4, 8 };
+    case DXGI_FORMAT_BC2_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC2_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC2_UNORM_SRGB: [[fallthrough]];
+    case DXGI_FORMAT_BC3_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC3_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC3_UNORM_SRGB: [[fallthrough]];
+    case DXGI_FORMAT_BC5_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC5_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC5_UNORM_SRGB: [[fallthrough]];
+    case DXGI_FORMAT_BC7_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC7_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC7_UNORM_SRGB: return BlockInfo{ 4, 16 };
+    default: return {};
+    }
+}
+
+static uint64_t surfaceBytes( const BlockInfo& info, uint32_t width, uint32_t height )
+{
+    assert( info.extent );
+    const uint64_t blocksX = ( width + info.extent - 1 ) / info.extent;
+    const uint64_t blocksY = ( height + info.extent - 1 ) / info.extent;
+    return blocksX * blocksY * info.bytes;
+}
+
+static bool isVolume( const DDSHeader& header )
+{
+    return ( header.caps2 & DDSHeader::fVolume )
+        && ( header.flags & DDSHeader::fDepth )
+        && header.depth > 1;
+}
+
+// NOTE: legacy cubemaps store only the faces flagged, each with its own mip chain
+static uint32_t cubeFaces( const DDSHeader& header )
+{
+    if ( !( header.caps2 & DDSHeader::fCubemap ) ) return 1;
+    return std::max( (uint32_t)__builtin_popcount( header.caps2 & DDSHeader::fCubemapFaces ), 1u );
+}
+
+// NOTE: volume mips are stored one after another, each holding all of its depth slices.
+//       Pick the middle slice of the smallest mip still covering the target size
+//       and rewrite the header to describe just that slice as a plain 2D surface.
+static bool selectVolumeSlice( DDSHeader& header, const BlockInfo& info, uint32_t targetWidth, uint32_t targetHeight, uint64_t& offset, uint32_t& level )
+{
+    if ( !info.extent || !info.bytes ) {
+        LOG( "Unsupported volume texture format, maybe TODO" );
+        return false;
+    }
+
+    // NOTE: legacy pitch only describes top level rows, don't guess the layout of smaller mips
+    const bool hasPitch = header.flags & DDSHeader::fPitch;
+    const bool hasMips = ( header.flags & DDSHeader::fMipMapCount ) && header.mipMapCount > 1;
+    const bool topLevel = !targetWidth && !targetHeight;
+    const uint32_t mipCount = hasMips && !hasPitch && !topLevel ? std::min( header.mipMapCount, 32u ) : 1;
+    targetWidth = std::max( targetWidth, 1u );
+    targetHeight = std::max( targetHeight, 1u );
+
+    uint32_t width = header.width;
+    uint32_t height = header.height;
+    uint32_t depth = std::max( header.depth, 1u );
+    for ( uint32_t mip = 1; mip < mipCount; ++mip ) {
+        if ( width == 1 && height == 1 ) break;
+        const uint32_t nextWidth = std::max( width >> 1, 1u );
+        const uint32_t nextHeight = std::max( height >> 1, 1u );
+        if ( nextWidth < targetWidth && nextHeight < targetHeight ) break;
+        offset += surfaceBytes( info, width, height ) * depth;
+        level = mip;
+        width = nextWidth;
+        height = nextHeight;
+        depth = std::max( depth >> 1, 1u );
+    }
+
+    const uint64_t sliceBytes = hasPitch
+        ? (uint64_t)header.pitchOrLinearSize * (uint64_t)height
+        : surfaceBytes( info, width, height );
+    offset += sliceBytes * ( depth / 2 );
+    header.width = width;
+    header.height = height;
+    header.depth = 1;
+    return true;
+}
+
+static Codec fourCCCodec( uint32_t fourCC, Colorspace& colorspace )
+{
+    switch ( fourCC ) {
+    case '1TXD': return Codec::eBC1;
+    case '2TXD': [[fallthrough]];
+    case '3TXD': return Codec::eBC2;
+    case '4TXD': [[fallthrough]];
+    case '5TXD': return Codec::eBC3;
+    case 'U4CB': [[fallthrough]];
+    case '1ITA': return Codec::eBC4;
+    case 'S4CB': colorspace = Colorspace::eSRGB; return Codec::eBC4;
+    case 'U5CB': [[fallthrough]];
+    case '2ITA': return Codec::eBC5;
+    case 'S5CB': colorspace = Colorspace::eSRGB; return Codec::eBC5;
+    default: return Codec::eNone;
+    }
+}
+
+static Codec dxgiCodec( uint32_t format, Colorspace& colorspace )
+{
+    switch ( format ) {
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_UNORM_SRGB:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        colorspace = Colorspace::eSRGB;
+        break;
+    default:
+        break;
+    }
+
+    switch ( format ) {
+    case DXGI_FORMAT_BC1_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC1_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC1_UNORM_SRGB: return Codec::eBC1;
+
+    case DXGI_FORMAT_BC2_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC2_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC2_UNORM_SRGB: return Codec::eBC2;
+
+    case DXGI_FORMAT_BC3_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC3_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC3_UNORM_SRGB: return Codec::eBC3;
+
+    case DXGI_FORMAT_BC4_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC4_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC4_UNORM_SRGB: return Codec::eBC4;
+
+    case DXGI_FORMAT_BC5_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC5_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC5_UNORM_SRGB: return Codec::eBC5;
+
+    case DXGI_FORMAT_B5G5R5A1_UNORM: return Codec::eB5G5R5A1;
+    case DXGI_FORMAT_B5G6R5_UNORM: return Codec::eB5G6R5;
+    case DXGI_FORMAT_B8G8R8A8_UNORM: return Codec::eB8G8R8A8;
+    case DXGI_FORMAT_R8_UNORM: return Codec::eR8;
+
+    case DXGI_FORMAT_BC7_TYPELESS: [[fallthrough]];
+    case DXGI_FORMAT_BC7_UNORM: [[fallthrough]];
+    case DXGI_FORMAT_BC7_UNORM_SRGB: return Codec::eBC7;
+
+    case DXGI_FORMAT_B4G4R4A4_UNORM: return Codec::eB4G4R4A4;
+    default: return Codec::eNone;
+    }
+}
+
+// NOTE: if "common" format lookup not found, use slower deswizzler (its about 5x slower than known conversion function),
+// no guarantees its 100% accurate for every possible permutation
+static Codec uncompressedCodec( const PixelFormat& pixelFormat, Layout& layout )
+{
+    struct Fmt {
+        uint32_t bitCount;
+        std::array<uint32_t, 4> bitMasks;
+        Codec codec;
+    };
+
+    static constexpr Fmt LUT[] = {
+        Fmt{ 32, { 0x00FF0000u, 0x0000FF00u, 0x00000000FFu, 0xFF000000u }, Codec::eB8G8R8A8 },
+        Fmt{ 24, { 0x00FF0000u, 0x0000FF00u, 0x00000000FFu, 0x00000000u }, Codec::eB8G8R8 },
+        Fmt{ 16, { 0b1111100000000000u, 0b0000011111100000u, 0b0000000000011111u, 0u, }, Codec::eB5G6R5 },
+        Fmt{ 16, { 0b0111110000000000u, 0b0000001111100000u, 0b0000000000011111u, 0b1000000000000000u, }, Codec::eB5G5R5A1 },
+        Fmt{ 8, { 0xFFu, 0u, 0u, 0u }, Codec::eR8 },
+        Fmt{ 8, { 0u, 0u, 0u, 0xFFu }, Codec::eR8 },
+    };
+    // TODO: expected 0 in mask if unused, clear per flags bits if found problematic
+    const std::array<uint32_t, 4> mask{
+        pixelFormat.bitmaskR,
+        pixelFormat.bitmaskG,
+        pixelFormat.bitmaskB,
+        pixelFormat.bitmaskA,
+    };
+    for ( auto&& fmt : LUT ) {
+        if ( fmt.bitCount == pixelFormat.rgbBitCount && fmt.bitMasks == mask ) return fmt.codec;
+    }
+
+    const bool hasAlphaPixels = !!( pixelFormat.flags & PixelFormat::fAlphaPixels );
+    const uint32_t alphaMask = hasAlphaPixels ? pixelFormat.bitmaskA : 0u;
+    if ( pixelFormat.flags & PixelFormat::fRGB ) {
+        layout.masks[ 0 ] = pixelFormat.bitmaskR;
+        layout.masks[ 1 ] = pixelFormat.bitmaskG;
+        layout.masks[ 2 ] = pixelFormat.bitmaskB;
+        layout.masks[ 3 ] = alphaMask;
+    }
+    else if ( pixelFormat.flags & PixelFormat::fLuminance ) {
+        layout.masks[ 0 ] = pixelFormat.bitmaskR;
+        layout.masks[ 3 ] = alphaMask;
+    }
+    else if ( pixelFormat.flags & PixelFormat::fAlpha || hasAlphaPixels ) {
+        layout.masks[ 3 ] = pixelFormat.bitmaskA;
+    }
+    else {
+        return Codec::eNone;
+    }
+    return Codec::eDeswizzle;
+}
+
+// NOTE: bytes of a block, or a texel for uncompressed codecs
+static uint64_t unitBytes( const Layout& layout )
+{
+    return layout.texelsPerRow == 4 ? layout.rowPitch / ( layout.width / 4 ) : layout.bytesPerPixel;
+}
+
+// NOTE: steps to the next smaller level, stored right after the current one
+static void nextMip( Layout& layout, uint64_t unitBytes )
+{
+    layout.offset += layout.bytes();
+    layout.oWidth = std::max( layout.oWidth >> 1, 1u );
+    layout.oHeight = std::max( layout.oHeight >> 1, 1u );
+    if ( layout.texelsPerRow == 4 ) {
+        layout.width = ( layout.oWidth + 3u ) & ~3u;
+        layout.height = ( layout.oHeight + 3u ) & ~3u;
+        layout.rowPitch = (uint64_t)( layout.width / 4 ) * unitBytes;
+        layout.rowCount = layout.height / 4;
+    }
+    else {
+        layout.width = layout.oWidth;
+        layout.height = layout.oHeight;
+        layout.rowPitch = (uint64_t)layout.width * unitBytes;
+        layout.rowCount = layout.height;
+    }
+}
+
+// NOTE: Xbox One surfaces are padded to the alignments of the GPU address library, linear rows to 64 elements
+//       and 256 bytes, 1D tiled rows to whole micro tiles and 256 bytes per row of them.
+//       Only the top level is located, smaller mips depend on base alignment and are not needed often enough
+static bool xboxLayout( const XBOXHeader& xbox, const BlockInfo& info, Layout& layout )
+{
+    auto alignUp = []( uint32_t v, uint32_t a ) { return ( v + a - 1 ) / a * a; };
+    const uint32_t elementsX = layout.width / info.extent;
+    const uint32_t elementsY = layout.height / info.extent;
+    switch ( xbox.tileMode ) {
+    case XBOXHeader::eLinear: {
+        const uint32_t pitch = alignUp( elementsX, std::max( 64u, 256u / info.bytes ) );
+        layout.width = pitch * info.extent;
+        layout.rowPitch = (uint64_t)pitch * info.bytes;
+        return true;
+    }
+    case XBOXHeader::eDisplay1D: layout.tiling = Tiling::eDisplay; break;
+    case XBOXHeader::eThin1D: layout.tiling = Tiling::eThin; break;
+    default:
+        LOG( "Unsupported Xbox tile mode, maybe TODO" );
+        return false;
+    }
+    if ( !tileSwizzle( layout.tiling, info.bytes ).xMask ) {
+        LOG( "Unsupported tiled element size, maybe TODO" );
+        return false;
+    }
+
+    const uint32_t pitch = alignUp( elementsX, std::max( 8u, 32u / info.bytes ) );
+    const uint32_t tileRows = alignUp( elementsY, 8 ) / 8;
+    layout.width = pitch * info.extent;
+    layout.height = tileRows * 8 * info.extent;
+    layout.texelsPerRow = 8 * info.extent;
+    layout.rowPitch = (uint64_t)pitch * 8 * info.bytes;
+    layout.rowCount = tileRows;
+    return true;
+}
+
+static bool validateHeader( const DDSHeader& header )
+{
+    if ( header.magic != DDSHeader::MAGIC ) {
+        LOG( "Magic field not 'DDS '" );
+        return false;
+    }
+
+    if ( header.size != DDSHeader::SIZE ) {
+        LOG( "Header .size not 124" );
+        return false;
+    }
+
+    if ( ~header.flags & ( DDSHeader::fCaps | DDSHeader::fHeight | DDSHeader::fWidth | DDSHeader::fPixelFormat ) ) {
+        LOG( "Missing .flags ( caps | width | height | pixelformat )" );
+        return false;
+    }
+
+    if ( ~header.caps & DDSHeader::Caps::fTexture ) {
+        LOG( "Missing .caps flag ( texture )" );
+        return false;
+    }
+
+    return true;
+}
+
+static bool withinPixelLimit( const DDSHeader& header )
+{
+    static constexpr uint64_t MAX_PIXEL_COUNT = 256u << 18; // 256MiB / sizeof( ARGB32 )
+    if ( (uint64_t)header.width * (uint64_t)header.height > MAX_PIXEL_COUNT ) {
+        LOG( "Intermediate thumbnail size exceeds arbitrary sane limit of 256MiB, file possibly corrupted" );
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+namespace dds {
+
+const char* name( Codec codec )
+{
+    switch ( codec ) {
+    case Codec::eBC1: return BC1::NAME;
+    case Codec::eBC2: return BC2::NAME;
+    case Codec::eBC3: return BC3::NAME;
+    case Codec::eBC4: return BC4::NAME;
+    case Codec::eBC5: return BC5::NAME;
+    case Codec::eBC7: return BC7::NAME;
+    case Codec::eB8G8R8A8: return "B8G8R8A8";
+    case Codec::eB8G8R8: return "B8G8R8";
+    case Codec::eB5G6R5: return "B5G6R5";
+    case Codec::eB5G5R5A1: return "B5G5R5A1";
+    case Codec::eB4G4R4A4: return "B4G4R4A4";
+    case Codec::eR8: return "R8";
+    case Codec::eDeswizzle: return "Deswizzle";
+    default: return "None";
+    }
+}
+
+static bool parseLayout( Span<const uint8_t> bytes, uint64_t fileSize, uint32_t targetWidth, uint32_t targetHeight, bool pixelLimit, Layout& layout )
+{
+    if ( bytes.size() < sizeof( DDSHeader ) || fileSize < sizeof( DDSHeader ) ) {
+        LOG( "File truncated, expected at least 128 bytes" );
+        return false;
+    }
+
+    DDSHeader header{};
+    std::memcpy( &header, bytes.data(), sizeof( DDSHeader ) );
+    if ( !validateHeader( header ) ) {
+        return false;
+    }
+    if ( pixelLimit && !withinPixelLimit( header ) ) {
+        return false;
+    }
+
+    Layout ret{};
+    uint64_t offset = sizeof( DDSHeader );
+    BlockInfo info{};
+    bool volume = false;
+    bool xbox = false;
+    XBOXHeader xboxHeader{};
+    uint64_t elements = 1;
+
+    if ( header.pixelFormat.flags == PixelFormat::fFourCC && header.pixelFormat.fourCC == '01XD' ) {
+        if ( bytes.size() < sizeof( DDSHeader ) + sizeof( DXGIHeader ) || fileSize < sizeof( DDSHeader ) + sizeof( DXGIHeader ) ) {
+            LOG( "File truncated or corrupted, not enough data to read dxgi header" );
+            return false;
+        }
+        DXGIHeader dxgiHeader{};
+        std::memcpy( &dxgiHeader, bytes.data() + sizeof( DDSHeader ), sizeof( DXGIHeader ) );
+        offset += sizeof( DXGIHeader );
+        switch ( dxgiHeader.dimension ) {
+        case DXGIHeader::eTexture2D: break;
+        case DXGIHeader::eTexture3D: volume = true; break;
+        default:
+            LOG( "Unsupported dimension - expected texture 2D or 3D" );
+            return false;
+        }
+        elements = (uint64_t)std::max( dxgiHeader.arraySize, 1u ) * ( dxgiHeader.flags & DXGIHeader::fTextureCube ? 6 : 1 );
+        ret.codec = dxgiCodec( dxgiHeader.format, ret.colorspace );
+        info = dxgiBlockInfo( dxgiHeader.format );
+        if ( ret.codec == Codec::eNone ) {
+            LOG( "Unsupported dxgi format, maybe TODO" );
+            return false;
+        }
+    }
+    else if ( header.pixelFormat.flags == PixelFormat::fFourCC && header.pixelFormat.fourCC == 'XOBX' ) {
+        if ( bytes.size() < sizeof( DDSHeader ) + sizeof( XBOXHeader ) || fileSize < sizeof( DDSHeader ) + sizeof( XBOXHeader ) ) {
+            LOG( "File truncated or corrupted, not enough data to read xbox header" );
+            return false;
+        }
+        std::memcpy( &xboxHeader, bytes.data() + sizeof( DDSHeader ), sizeof( XBOXHeader ) );
+        offset += sizeof( XBOXHeader );
+        xbox = true;
+        if ( xboxHeader.dimension != DXGIHeader::eTexture2D ) {
+            LOG( "Unsupported xbox dimension - expected texture 2D" );
+            return false;
+        }
+        ret.codec = dxgiCodec( xboxHeader.format, ret.colorspace );
+        info = dxgiBlockInfo( xboxHeader.format );
+        if ( ret.codec == Codec::eNone ) {
+            LOG( "Unsupported xbox dxgi format, maybe TODO" );
+            return false;
+        }
+    }
+    else if ( header.pixelFormat.flags == PixelFormat::fFourCC ) {
+        volume = isVolume( header );
+        elements = cubeFaces( header );
+        ret.codec = fourCCCodec( header.pixelFormat.fourCC, ret.colorspace );
+        info = fourCCBlockInfo( header.pixelFormat.fourCC );
+        if ( ret.codec == Codec::eNone ) {
+            LOG( "Unknown fourCC value" );
+            return false;
+        }
+    }
+    else {
+        if ( header.pixelFormat.flags & PixelFormat::fYUV ) {
+            LOG( "YUV images not supported, maybe TODO" );
+            return false;
+        }
+        switch ( header.pixelFormat.rgbBitCount ) {
+        case 8: [[fallthrough]];
+        case 16: [[fallthrough]];
+        case 24: [[fallthrough]];
+        case 32: break;
+        default:
+            LOG( "Suspicious pixel format, maybe TODO" );
+            return false;
+        }
+        volume = isVolume( header );
+        elements = cubeFaces( header );
+        ret.codec = uncompressedCodec( header.pixelFormat, ret );
+        info = BlockInfo{ 1, header.pixelFormat.rgbBitCount / 8 };
+        if ( ret.codec == Codec::eNone ) {
+            LOG( "Suspicious pixel format, maybe TODO" );
+            return false;
+        }
+    }
+
+    if ( volume && !selectVolumeSlice( header, info, targetWidth, targetHeight, offset, ret.mip ) ) {
+        return false;
+    }
+
+    ret.oWidth = header.width;
+    ret.oHeight = header.height;
+    ret.offset = offset;
+    if ( info.extent == 4 ) {
+        if ( header.flags & DDSHeader::fPitch ) {
+            LOG( "Suspicious BC format file with pitch flag, maybe TODO" );
+            return false;
+        }
+        auto align4 = []( uint32_t v ) { return ( v + 3u ) & ~3u; };
+        ret.width = align4( header.width );
+        ret.height = align4( header.height );
+        ret.texelsPerRow = 4;
+        ret.rowPitch = (uint64_t)( ret.width / 4 ) * info.bytes;
+        ret.rowCount = ret.height / 4;
+    }
+    else {
+        ret.width = header.width;
+        ret.height = header.height;
+        ret.bytesPerPixel = info.bytes;
+        ret.rowPitch = (uint64_t)header.width * info.bytes;
+        ret.rowCount = header.height;
+        if ( header.flags & DDSHeader::fPitch ) {
+            if ( header.pitchOrLinearSize < ret.rowPitch ) {
+                LOG( "Suspicious pitch value, maybe TODO" );
+                return false;
+            }
+            ret.rowPitch = header.pitchOrLinearSize;
+        }
+    }
+
+    if ( !ret.width || !ret.height ) {
+        LOG( "Empty image" );
+        return false;
+    }
+    if ( xbox && !xboxLayout( xboxHeader, info, ret ) ) {
+        return false;
+    }
+    if ( xbox && xboxHeader.dataSize && xboxHeader.dataSize < ret.bytes() ) {
+        LOG( "Xbox data size smaller than top level, file possibly corrupted" );
+        return false;
+    }
+    if ( fileSize < ret.offset + ret.bytes() ) {
+        LOG( "File truncated or corrupted, not enough data to read" );
+        return false;
+    }
+
+    // NOTE: volume slices of smaller mips are not contiguous, legacy pitch only describes top level rows
+    const bool hasMips = ( header.flags & DDSHeader::fMipMapCount ) && header.mipMapCount > 1;
+    const bool padded = ret.texelsPerRow == 1 && ret.rowPitch != (uint64_t)ret.width * ret.bytesPerPixel;
+    if ( hasMips && !volume && !padded && !xbox ) {
+        ret.mipCount = std::min( header.mipMapCount, 32u );
+    }
+
+    // NOTE: elements are located only when their whole mip chain is, and all of them are in the file
+    const uint32_t chainLength = hasMips ? header.mipMapCount : 1;
+    if ( elements > 1 && !volume && !padded && !xbox && chainLength <= 32 ) {
+        Layout level = ret;
+        const uint64_t unit = unitBytes( ret );
+        for ( uint32_t i = 1; i < chainLength; ++i ) {
+            nextMip( level, unit );
+        }
+        const uint64_t stride = level.offset + level.bytes() - ret.offset;
+        if ( stride * elements <= fileSize - ret.offset ) {
+            ret.elementStride = stride;
+            ret.elementCount = (uint32_t)std::min<uint64_t>( elements, UINT32_MAX );
+        }
+    }
+
+    layout = ret;
+    return true;
+}
+
+bool parseLayout( Span<const uint8_t> header, uint64_t fileSize, uint32_t targetWidth, uint32_t targetHeight, Layout& layout )
+{
+    return parseLayout( header, fileSize, targetWidth, targetHeight, true, layout );
+}
+
+bool inspectLayout( Span<const uint8_t> header, uint64_t fileSize, Layout& layout )
+{
+    return parseLayout( header, fileSize, 0, 0, false, layout );
+}
+
+bool mipLayout( const Layout& layout, uint32_t level, uint64_t fileSize, Layout& out )
+{
+    if ( level >= layout.mipCount ) {
+        LOG( "Mip level out of range" );
+        return false;
+    }
+
+    Layout ret = layout;
+    const uint64_t unit = unitBytes( layout );
+    for ( uint32_t i = 0; i < level; ++i ) {
+        nextMip( ret, unit );
+    }
+    ret.mip = layout.mip + level;
+    ret.mipCount = layout.mipCount - level;
+
+    if ( fileSize < ret.offset + ret.bytes() ) {
+        LOG( "File truncated or corrupted, mip level past the end" );
+        return false;
+    }
+    out = ret;
+    return true;
+}
+
+bool elementLayout( const Layout& layout, uint32_t element, uint64_t fileSize, Layout& out )
+{
+    assert( !layout.element && !layout.mip );
+    if ( element >= layout.elementCount ) {
+        LOG( "Array element out of range" );
+        return false;
+    }
+
+    Layout ret = layout;
+    ret.offset += layout.elementStride * element;
+    ret.element = element;
+    if ( fileSize < ret.offset + ret.bytes() ) {
+        LOG( "File truncated or corrupted, array element past the end" );
+        return false;
+    }
+    out = ret;
+    return true;
+}
+
+bool decodeRows( const Layout& layout, Span<const uint8_t> rows, uint32_t* argb, size_t strideBytes, DecodeStats* stats )
+{
+    assert( argb );
+    assert( strideBytes % sizeof( uint32_t ) == 0 );
+    if ( !layout.rowPitch || rows.size() % layout.rowPitch ) {
+        LOG( "Partial rows given to decode" );
+        return false;
+    }
+
+    const uint64_t count = rows.size() / layout.rowPitch;
+    const size_t stride = strideBytes / sizeof( uint32_t );
+    const uint8_t* src = rows.data();
+    DecodeStats local{};
+    if ( layout.tiling != Tiling::eLinear ) {
+        if ( !decodeTiledRows( layout, src, count, argb, stride, local ) ) return false;
+        if ( stats ) {
+            *stats += local;
+        }
+        return true;
+    }
+    switch ( layout.codec ) {
+    case Codec::eBC1: local = decompressBlocks( reinterpret_cast<const BC1*>( src ), count, layout.width, argb, stride ); break;
+    case Codec::eBC2: local = decompressBlocks( reinterpret_cast<const BC2*>( src ), count, layout.width, argb, stride ); break;
+    case Codec::eBC3: local = decompressBlocks( reinterpret_cast<const BC3*>( src ), count, layout.width, argb, stride ); break;
+    case Codec::eBC4: local = decompressBlocks( reinterpret_cast<const BC4*>( src ), count, layout.width, argb, stride ); break;
+    case Codec::eBC5: local = decompressBlocks( reinterpret_cast<const BC5*>( src ), count, layout.width, argb, stride ); break;
+    case Codec::eBC7: local = decompressBlocks( reinterpret_cast<const BC7*>( src ), count, layout.width, argb, stride ); break;
+    case Codec::eB8G8R8A8: copyRows( src, count, layout.rowPitch, layout.width, argb, stride ); break;
+    case Codec::eB8G8R8: convertRows<Byte3>( src, count, layout.rowPitch, layout.width, argb, stride, &colorfn::b8g8r8 ); break;
+    case Codec::eB5G6R5: convertRows<uint16_t>( src, count, layout.rowPitch, layout.width, argb, stride, &colorfn::b5g6r5 ); break;
+    case Codec::eB5G5R5A1: convertRows<uint16_t>( src, count, layout.rowPitch, layout.width, argb, stride, &colorfn::b5g5r5a1 ); break;
+    case Codec::eB4G4R4A4: convertRows<uint16_t>( src, count, layout.rowPitch, layout.width, argb, stride, &colorfn::b4g4r4a4 ); break;
+    case Codec::eR8: convertRows<uint8_t>( src, count, layout.rowPitch, layout.width, argb, stride, &colorfn::r8 ); break;
+    case Codec::eDeswizzle:
+        if ( layout.bytesPerPixel < 1 || layout.bytesPerPixel > 4 ) {
+            LOG( "Suspicious pixel format, maybe TODO" );
+            return false;
+        }
+        deswizzleRows( layout, src, count, argb, stride );
+        break;
+    default:
+        LOG( "Nothing to decode" );
+        return false;
+    }
+    if ( stats ) {
+        *stats += local;
+    }
+    return true;
+}
+
+bool decode( const Layout& layout, Span<const uint8_t> payload, uint32_t* argb, size_t strideBytes, DecodeStats* stats )
+{
+    if ( payload.size() < layout.bytes() ) {
+        LOG( "File truncated or corrupted, not enough data to read" );
+        return false;
+    }
+    return decodeRows( layout, payload.subspan( 0, layout.bytes() ), argb, strideBytes, stats );
+}
+
+} // namespace dds
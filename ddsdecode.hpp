@@ -0,0 +1,156 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Decoder library, no Qt and no I/O.
+// Caller reads the header, asks for the layout of the subresource to decode,
+// reads its byte range however it likes and hands it over together with an output buffer.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dds {
+
+// NOTE: pointer and size, std::span stand-in until the project moves past C++17
+template <typename T>
+class Span {
+    T* m_data = nullptr;
+    size_t m_size = 0;
+
+public:
+    constexpr Span() = default;
+    constexpr Span( T* data, size_t size )
+    : m_data{ data }
+    , m_size{ size }
+    {}
+
+    constexpr T* data() const { return m_data; }
+    constexpr size_t size() const { return m_size; }
+    constexpr bool empty() const { return m_size == 0; }
+    constexpr T* begin() const { return m_data; }
+    constexpr T* end() const { return m_data + m_size; }
+    constexpr T& operator [] ( size_t i ) const { return m_data[ i ]; }
+    constexpr Span subspan( size_t offset, size_t count ) const { return Span{ m_data + offset, count }; }
+};
+
+enum Colorspace : uint32_t {
+    eUNORM,
+    eSRGB,
+};
+
+enum class Codec : uint32_t {
+    eNone,
+    eBC1,
+    eBC2,
+    eBC3,
+    eBC4,
+    eBC5,
+    eBC7,
+    eB8G8R8A8,
+    eB8G8R8,
+    eB5G6R5,
+    eB5G5R5A1,
+    eB4G4R4A4,
+    eR8,
+    eDeswizzle, // arbitrary channel masks, see Layout::masks
+};
+
+// NOTE: element order of GPU tiled surfaces, stored rows of tiled layouts are rows of 8x8 element micro tiles,
+//       elements being blocks for block compressed codecs and texels otherwise
+enum class Tiling : uint32_t {
+    eLinear,
+    eThin, // Morton order
+    eDisplay, // displayable order, depends on element size
+};
+
+// NOTE: describes the subresource to decode and where its bytes are in the file.
+//       Stored rows are block rows for block compressed codecs, each covering 4 texel rows.
+struct Layout {
+    Codec codec = Codec::eNone;
+    Colorspace colorspace = eUNORM;
+    uint32_t width = 0; // decoded extent, what the output buffer must hold, block aligned
+    uint32_t height = 0;
+    uint32_t oWidth = 0; // visible extent
+    uint32_t oHeight = 0;
+    uint32_t texelsPerRow = 1; // texel rows covered by one stored row
+    Tiling tiling = Tiling::eLinear;
+    uint32_t bytesPerPixel = 0; // uncompressed codecs only
+    uint32_t masks[ 4 ]{}; // r, g, b, a for Codec::eDeswizzle
+    uint32_t mip = 0; // level picked
+    uint32_t mipCount = 1; // levels from mip down that mipLayout can locate
+    uint32_t element = 0; // array element or cube face picked
+    uint32_t elementCount = 1; // elements elementLayout can locate
+    uint64_t elementStride = 0; // bytes between elements, each holding a whole mip chain
+    uint64_t offset = 0; // of the first stored row from the start of the file
+    uint64_t rowPitch = 0; // bytes between stored rows
+    uint64_t rowCount = 0;
+
+    uint64_t bytes() const { return rowPitch * rowCount; }
+};
+
+struct DecodeStats {
+    int64_t blocks = 0;
+    int64_t uniform = 0; // filled with single color
+    int64_t repeated = 0; // identical to the block on the left, decoded once per run
+    int64_t bc7Modes[ 8 ]{}; // blocks per BC7 mode
+
+    DecodeStats& operator += ( const DecodeStats& rhs )
+    {
+        blocks += rhs.blocks;
+        uniform += rhs.uniform;
+        repeated += rhs.repeated;
+        for ( size_t i = 0; i < 8; ++i ) bc7Modes[ i ] += rhs.bc7Modes[ i ];
+        return *this;
+    }
+};
+
+const char* name( Codec codec );
+
+// NOTE: enough to hold the DDS header followed by the DX10 or XBOX extension
+static constexpr size_t MAX_HEADER_BYTES = 164;
+
+// NOTE: validates header and picks the subresource, top level for 2D textures,
+//       middle slice of the smallest mip covering target for volumes ( target of 0 means top level ).
+//       header holds the file from its start, 128 bytes are enough unless fourCC is DX10 or XBOX
+bool parseLayout( Span<const uint8_t> header, uint64_t fileSize, uint32_t targetWidth, uint32_t targetHeight, Layout& layout );
+
+// NOTE: top level as parseLayout would pick it, without the limit on decoded size,
+//       for reading dimensions and format of textures too large to be decoded
+bool inspectLayout( Span<const uint8_t> header, uint64_t fileSize, Layout& layout );
+
+// NOTE: layout of a smaller level of the same surface, level counts from layout.mip,
+//       fails if the level is past layout.mipCount or beyond the end of file
+bool mipLayout( const Layout& layout, uint32_t level, uint64_t fileSize, Layout& out );
+
+// NOTE: top level of another array element or cube face, layout must be the top level of the first one
+//       as returned by parseLayout, fails if element is past layout.elementCount or beyond the end of file
+bool elementLayout( const Layout& layout, uint32_t element, uint64_t fileSize, Layout& out );
+
+// NOTE: decodes whole stored rows, rows.size() must be a multiple of layout.rowPitch.
+//       argb receives rows.size() / rowPitch * texelsPerRow rows of layout.width pixels, strideBytes apart
+bool decodeRows( const Layout& layout, Span<const uint8_t> rows, uint32_t* argb, size_t strideBytes, DecodeStats* stats = nullptr );
+
+// NOTE: whole subresource, payload starts at layout.offset and holds at least layout.bytes()
+bool decode( const Layout& layout, Span<const uint8_t> payload, uint32_t* argb, size_t strideBytes, DecodeStats* stats = nullptr );
+
+} // namespace dds
@@ -0,0 +1,723 @@
+// MIT License
+//
+// Copyright (c) 2022 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Qt side of the decoder library, streams the selected subresource from QIODevice into pooled buffers
+
+#pragma once
+
+#include <QColorSpace>
+#include <QFileDevice>
+#include <QIODevice>
+#include <QImage>
+#include <QSize>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifndef NDEBUG
+#include <iostream>
+#define LOG( msg ) std::cerr << ( msg ) << "\n";
+#else
+#define LOG( msg ) {}
+#endif
+
+#include "bufferpool.hpp"
+#include "ddsdecode.hpp"
+#include "ddsformat.hpp"
+#include "memoryaccount.hpp"
+#include "trace.hpp"
+
+namespace {
+
+using dds::Colorspace;
+using dds::DDSHeader;
+using dds::DXGIHeader;
+using dds::PixelFormat;
+using dds::XBOXHeader;
+
+// NOTE: single core decode costs measured on this machine, indexed by codec, 0 where not measured
+struct DecodeCosts {
+    static constexpr size_t CODEC_COUNT = static_cast<size_t>( dds::Codec::eDeswizzle ) + 1;
+
+    double nsPerTexel[ CODEC_COUNT ]{};
+};
+
+struct DecodeContext {
+    BufferPool* pool = nullptr;
+    const DecodeCosts* costs = nullptr; // built in guesses when null
+    MemoryAccount* account = nullptr;
+    QSize target{};
+    uint32_t shrink = 1; // power of two, texels are box averaged while streaming so the full image is never held
+    bool sampled = false; // decode one block or texel out of each shrink x shrink area instead of all of them
+    std::chrono::nanoseconds budget{ 0 }; // of the whole request, 0 for unbounded
+    std::chrono::steady_clock::time_point deadline{};
+    bool readerThread = true; // slow decodes read the next band of rows on a second thread
+};
+
+// NOTE: estimated decode time below which a single read is cheaper than spinning up the reader thread
+static constexpr qint64 PIPELINE_MIN_NS = 8'000'000;
+static constexpr qint64 PIPELINE_BAND_BYTES = 1u << 20;
+
+// NOTE: time budget never shrinks images below this, unlike the memory cap
+static constexpr uint32_t MIN_DEGRADED_EXTENT = 64;
+
+// NOTE: reader thread fills one band while the caller consumes the other, band after the one being read
+//       is hinted with fadvise so the disk stays ahead of the reader; bands end up a multiple of bandBytes
+inline bool readOverlapped( int fd, qint64 offset, qint64 totalBytes, qint64 bandBytes, BufferPool& pool, MemoryAccount* account
+    , const std::function<void( const char*, qint64 )>& consume )
+{
+    Buffer<char> bands[ 2 ]{ Buffer<char>{ pool, bandBytes }, Buffer<char>{ pool, bandBytes } };
+    if ( bands[ 0 ].empty() || bands[ 1 ].empty() ) {
+        LOG( "Failed to allocate read band" );
+        return false;
+    }
+    const MemoryCharge charges[ 2 ]{ { account, MemoryAccount::eReadBand, bandBytes }, { account, MemoryAccount::eReadBand, bandBytes } };
+
+    const qint64 bandCount = ( totalBytes + bandBytes - 1 ) / bandBytes;
+    auto bandSize = [=]( qint64 i ) { return std::min( bandBytes, totalBytes - i * bandBytes ); };
+
+    std::mutex mutex{};
+    std::condition_variable changed{};
+    qint64 filled[ 2 ]{ -1, -1 }; // bytes in band, -1 when free
+    bool cancelled = false;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise( fd, offset, totalBytes, POSIX_FADV_SEQUENTIAL );
+    posix_fadvise( fd, offset, bandBytes, POSIX_FADV_WILLNEED );
+#endif
+
+    std::thread reader{ [&]()
+    {
+        for ( qint64 i = 0; i < bandCount; ++i ) {
+            const int slot = i & 1;
+            {
+                std::unique_lock<std::mutex> lock{ mutex };
+                changed.wait( lock, [&]() { return filled[ slot ] < 0 || cancelled; } );
+                if ( cancelled ) return;
+            }
+            const qint64 begin = offset + i * bandBytes;
+            const qint64 bytes = bandSize( i );
+#ifdef POSIX_FADV_WILLNEED
+            if ( i + 1 < bandCount ) {
+                posix_fadvise( fd, begin + bandBytes, bandSize( i + 1 ), POSIX_FADV_WILLNEED );
+            }
+#endif
+            TraceScope trace{ "read" };
+            trace.arg( "bytes", bytes );
+            qint64 done = 0;
+            while ( done < bytes ) {
+                const ssize_t ret = pread( fd, bands[ slot ].data() + done, static_cast<size_t>( bytes - done ), begin + done );
+                if ( ret < 0 && errno == EINTR ) continue;
+                if ( ret <= 0 ) break;
+                done += ret;
+            }
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                filled[ slot ] = done;
+            }
+            changed.notify_all();
+            if ( done != bytes ) return;
+        }
+    } };
+
+    bool ok = true;
+    for ( qint64 i = 0; i < bandCount; ++i ) {
+        const int slot = i & 1;
+        qint64 bytes = 0;
+        {
+            std::unique_lock<std::mutex> lock{ mutex };
+            changed.wait( lock, [&]() { return filled[ slot ] >= 0; } );
+            bytes = filled[ slot ];
+        }
+        if ( bytes != bandSize( i ) ) {
+            LOG( "Read failed" );
+            ok = false;
+            break;
+        }
+        consume( bands[ slot ].data(), bytes );
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            filled[ slot ] = -1;
+        }
+        changed.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        cancelled = true;
+    }
+    changed.notify_all();
+    reader.join();
+    return ok;
+}
+
+struct ImageData {
+    Buffer<uint32_t> pixels;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t oWidth = 0;
+    uint32_t oHeight = 0;
+    Colorspace colorspace = Colorspace::eUNORM;
+    bool extentNeedsResize = false;
+    uint32_t shrink = 1; // may end up larger than planned when decoding falls behind deadline
+    MemoryCharge charge{};
+};
+
+// NOTE: reads header, and DX10 or XBOX extension when present, then picks the subresource to decode
+inline bool readLayout( QIODevice* file, const QSize& target, dds::Layout& layout, DDSHeader* headerOut = nullptr )
+{
+    assert( file );
+    TraceScope trace{ "header" };
+
+    uint8_t bytes[ dds::MAX_HEADER_BYTES ]{};
+    qint64 size = file->read( reinterpret_cast<char*>( bytes ), sizeof( DDSHeader ) );
+    if ( size != static_cast<qint64>( sizeof( DDSHeader ) ) ) {
+        LOG( "File truncated, expected at least 128 bytes" );
+        return false;
+    }
+
+    DDSHeader header{};
+    std::memcpy( &header, bytes, sizeof( DDSHeader ) );
+    if ( header.pixelFormat.flags == PixelFormat::fFourCC && header.pixelFormat.fourCC == '01XD' ) {
+        size += std::max<qint64>( file->read( reinterpret_cast<char*>( bytes ) + size, sizeof( DXGIHeader ) ), 0 );
+    }
+    else if ( header.pixelFormat.flags == PixelFormat::fFourCC && header.pixelFormat.fourCC == 'XOBX' ) {
+        size += std::max<qint64>( file->read( reinterpret_cast<char*>( bytes ) + size, sizeof( XBOXHeader ) ), 0 );
+    }
+
+    const uint32_t targetWidth = static_cast<uint32_t>( std::max( target.width(), 0 ) );
+    const uint32_t targetHeight = static_cast<uint32_t>( std::max( target.height(), 0 ) );
+    if ( !dds::parseLayout( dds::Span<const uint8_t>{ bytes, static_cast<size_t>( size ) }, static_cast<uint64_t>( file->size() ), targetWidth, targetHeight, layout ) ) {
+        return false;
+    }
+    if ( headerOut ) {
+        *headerOut = header;
+    }
+    trace.arg( "format", dds::name( layout.codec ) );
+    trace.arg( "width", layout.oWidth );
+    trace.arg( "height", layout.oHeight );
+    trace.arg( "mip", layout.mip );
+    return true;
+}
+
+// NOTE: box average of shrink x shrink texels, boxes cut by right or bottom edge average what they cover
+inline void reduceBand( const uint32_t* src, uint32_t width, uint32_t rows, uint32_t shrink, uint32_t* dst, uint32_t dstWidth )
+{
+    for ( uint32_t y = 0; y < rows; y += shrink ) {
+        const uint32_t boxRows = std::min( shrink, rows - y );
+        uint32_t* dstRow = dst + (size_t)( y / shrink ) * dstWidth;
+        for ( uint32_t dx = 0; dx < dstWidth; ++dx ) {
+            const uint32_t x = dx * shrink;
+            const uint32_t boxColumns = std::min( shrink, width - x );
+            uint32_t sum[ 4 ]{};
+            for ( uint32_t by = 0; by < boxRows; ++by ) {
+                const uint32_t* texel = src + (size_t)( y + by ) * width + x;
+                for ( uint32_t bx = 0; bx < boxColumns; ++bx ) {
+                    sum[ 0 ] += texel[ bx ] & 0xFFu;
+                    sum[ 1 ] += ( texel[ bx ] >> 8 ) & 0xFFu;
+                    sum[ 2 ] += ( texel[ bx ] >> 16 ) & 0xFFu;
+                    sum[ 3 ] += texel[ bx ] >> 24;
+                }
+            }
+            const uint32_t count = boxRows * boxColumns;
+            auto average = [=]( uint32_t v ) { return ( v + count / 2 ) / count; };
+            dstRow[ dx ] = average( sum[ 0 ] )
+                | ( average( sum[ 1 ] ) << 8 )
+                | ( average( sum[ 2 ] ) << 16 )
+                | ( average( sum[ 3 ] ) << 24 );
+        }
+    }
+}
+
+inline uint32_t shrunk( uint32_t extent, uint32_t shrink )
+{
+    return ( extent + shrink - 1 ) / shrink;
+}
+
+// NOTE: stored rows and blocks, or texels, between samples
+inline uint32_t sampleStep( const dds::Layout& layout, uint32_t shrink )
+{
+    return std::max( shrink / layout.texelsPerRow, 1u );
+}
+
+// NOTE: bytes of a block, or a texel for uncompressed codecs
+inline uint64_t unitBytes( const dds::Layout& layout )
+{
+    return layout.texelsPerRow == 4 ? layout.rowPitch / ( layout.width / 4 ) : layout.bytesPerPixel;
+}
+
+inline qint64 bandRowsFor( const dds::Layout& layout, uint32_t shrink )
+{
+    // NOTE: every band but the last must cover whole boxes
+    const qint64 step = sampleStep( layout, shrink );
+    const qint64 rows = std::clamp<qint64>( PIPELINE_BAND_BYTES / static_cast<qint64>( layout.rowPitch ), 1, layout.rowCount );
+    return ( rows + step - 1 ) / step * step;
+}
+
+// NOTE: worst case bytes held at once by decodeImage, toImage and scaleThumbnail
+inline qint64 estimateDecodeBytes( const dds::Layout& layout, uint32_t shrink, bool sampled, const QSize& target )
+{
+    const qint64 bandRows = bandRowsFor( layout, shrink );
+    const qint64 band = std::min<qint64>( bandRows * layout.rowPitch, layout.bytes() );
+    const qint64 readBands = band * ( (uint64_t)band < layout.bytes() ? 2 : 1 );
+    const qint64 outWidth = shrunk( layout.width, shrink );
+    const qint64 scratch = !sampled && shrink > 1 ? bandRows * layout.texelsPerRow * layout.width * 4
+        : sampled ? outWidth * ( (qint64)unitBytes( layout ) + layout.texelsPerRow * layout.texelsPerRow * 4 )
+        : 0;
+    const qint64 pixels = outWidth * shrunk( layout.height, shrink ) * 4;
+    const qint64 crop = layout.width != layout.oWidth || layout.height != layout.oHeight
+        ? (qint64)shrunk( layout.oWidth, shrink ) * shrunk( layout.oHeight, shrink ) * 4
+        : 0;
+    const qint64 scaled = (qint64)std::max( target.width(), 0 ) * std::max( target.height(), 0 ) * 4;
+    return readBands + scratch + pixels + crop + scaled;
+}
+
+// NOTE: rough single core costs on a desktop CPU unless measured, run ddsbench for a full picture
+inline double decodeNsPerTexel( dds::Codec codec, const DecodeCosts* costs )
+{
+    const size_t index = static_cast<size_t>( codec );
+    if ( costs && index < DecodeCosts::CODEC_COUNT && costs->nsPerTexel[ index ] > 0.0 ) {
+        return costs->nsPerTexel[ index ];
+    }
+    switch ( codec ) {
+    case dds::Codec::eBC1: return 1.0;
+    case dds::Codec::eBC2: return 1.2;
+    case dds::Codec::eBC3: return 1.5;
+    case dds::Codec::eBC4: return 0.8;
+    case dds::Codec::eBC5: return 1.5;
+    case dds::Codec::eBC7: return 4.0;
+    case dds::Codec::eB8G8R8A8: return 0.2;
+    case dds::Codec::eDeswizzle: return 1.5;
+    default: return 0.8;
+    }
+}
+
+static constexpr double READ_NS_PER_BYTE = 2.0;
+
+// NOTE: sampled decode reads only the stored rows it samples, but all of each row
+inline qint64 estimateDecodeNs( const dds::Layout& layout, uint32_t shrink, bool sampled, const DecodeCosts* costs )
+{
+    const double step = sampled ? sampleStep( layout, shrink ) : 1.0;
+    const double texels = (double)layout.width * layout.height / ( step * step );
+    return static_cast<qint64>( texels * decodeNsPerTexel( layout.codec, costs ) + layout.bytes() / step * READ_NS_PER_BYTE );
+}
+
+// NOTE: smallest shrink fitting the cap, 0 cap means unlimited
+inline uint32_t pickShrink( const dds::Layout& layout, const QSize& target, qint64 cap, bool sampled = false )
+{
+    uint32_t shrink = sampled ? layout.texelsPerRow * 2 : 1;
+    if ( cap <= 0 ) return shrink;
+    while ( estimateDecodeBytes( layout, shrink, sampled, target ) > cap && shrunk( std::max( layout.width, layout.height ), shrink ) > 1 ) {
+        shrink *= 2;
+    }
+    return shrink;
+}
+
+// NOTE: smallest mip still covering margin times the target in either dimension, Qt::KeepAspectRatio scales it down, never up.
+//       0 margin keeps the level as is
+inline void selectCoveringMip( dds::Layout& layout, uint64_t fileSize, const QSize& target, uint32_t margin = 1 )
+{
+    if ( !margin ) return;
+    const uint32_t targetWidth = static_cast<uint32_t>( std::max( target.width(), 1 ) ) * margin;
+    const uint32_t targetHeight = static_cast<uint32_t>( std::max( target.height(), 1 ) ) * margin;
+    while ( layout.mipCount > 1 ) {
+        dds::Layout next{};
+        if ( !dds::mipLayout( layout, 1, fileSize, next ) ) break;
+        if ( next.oWidth < targetWidth && next.oHeight < targetHeight ) break;
+        layout = next;
+    }
+}
+
+// NOTE: largest power of two shrink still covering margin times the target, unless planDecode already reduced the decode.
+//       Averaging keeps every texel, sampling decodes one block or texel out of each area, tiled layouts are only averaged
+inline void planCoveringShrink( const dds::Layout& layout, uint32_t margin, bool sample, DecodeContext& ctx )
+{
+    if ( !margin || ctx.shrink > 1 || ctx.sampled ) return;
+    const uint32_t targetWidth = static_cast<uint32_t>( std::max( ctx.target.width(), 1 ) ) * margin;
+    const uint32_t targetHeight = static_cast<uint32_t>( std::max( ctx.target.height(), 1 ) ) * margin;
+    const uint32_t extent = std::max( layout.oWidth, layout.oHeight );
+    uint32_t shrink = 1;
+    while ( shrink * 2 <= extent
+        && ( shrunk( layout.oWidth, shrink * 2 ) >= targetWidth || shrunk( layout.oHeight, shrink * 2 ) >= targetHeight ) ) {
+        shrink *= 2;
+    }
+    ctx.shrink = shrink;
+    ctx.sampled = sample && shrink > layout.texelsPerRow && layout.tiling == dds::Tiling::eLinear;
+}
+
+// NOTE: cheapest adequate strategy within ctx.budget and the memory cap, in order:
+//       top level, smallest mip still covering target, that mip shrunk by averaging when only memory is short,
+//       that mip sampled sparsely enough to fit the budget. Tiled layouts are never sampled, their stored rows
+//       hold whole rows of micro tiles, they go over the budget shrunk only as far as the memory cap asks
+inline void planDecode( dds::Layout& layout, uint64_t fileSize, qint64 memoryCap, DecodeContext& ctx )
+{
+    const qint64 budgetNs = ctx.budget.count();
+    auto fitsTime = [budgetNs, &ctx]( const dds::Layout& l, uint32_t shrink, bool sampled )
+    {
+        return budgetNs <= 0 || estimateDecodeNs( l, shrink, sampled, ctx.costs ) <= budgetNs;
+    };
+    auto fitsMemory = [&ctx, memoryCap]( const dds::Layout& l, uint32_t shrink, bool sampled )
+    {
+        return memoryCap <= 0 || estimateDecodeBytes( l, shrink, sampled, ctx.target ) <= memoryCap;
+    };
+
+    ctx.shrink = 1;
+    ctx.sampled = false;
+    if ( fitsTime( layout, 1, false ) && fitsMemory( layout, 1, false ) ) return;
+
+    selectCoveringMip( layout, fileSize, ctx.target );
+
+    if ( fitsTime( layout, 1, false ) || layout.tiling != dds::Tiling::eLinear ) {
+        ctx.shrink = pickShrink( layout, ctx.target, memoryCap );
+        return;
+    }
+
+    uint32_t shrink = pickShrink( layout, ctx.target, memoryCap, true );
+    while ( !fitsTime( layout, shrink, true ) && shrunk( std::max( layout.width, layout.height ), shrink * 2 ) >= MIN_DEGRADED_EXTENT ) {
+        shrink *= 2;
+    }
+    ctx.shrink = shrink;
+    ctx.sampled = true;
+}
+
+// NOTE: payload is streamed in bands of stored rows, so only the decoded image is ever held whole.
+//       With a budget, progress is checked after every band, when the rest is projected to overrun the deadline
+//       what was decoded so far is averaged down and the remaining rows are sampled at that lower resolution.
+//       The device is left open, callers reading other subresources seek it again.
+inline ImageData decodeImage( const dds::Layout& layout, QIODevice* file, DecodeContext& ctx )
+{
+    assert( file );
+    assert( ctx.pool );
+    assert( ctx.shrink && !( ctx.shrink & ( ctx.shrink - 1 ) ) );
+    assert( !ctx.sampled || ctx.shrink > layout.texelsPerRow );
+    TraceScope trace{ "decode" };
+
+    uint32_t shrink = ctx.shrink;
+    bool sampled = ctx.sampled;
+    ImageData ret{};
+    auto allocatePixels = [&]()
+    {
+        ret.width = shrunk( layout.width, shrink );
+        ret.height = shrunk( layout.height, shrink );
+        ret.oWidth = shrunk( layout.oWidth, shrink );
+        ret.oHeight = shrunk( layout.oHeight, shrink );
+        ret.extentNeedsResize = ret.width != ret.oWidth || ret.height != ret.oHeight;
+        ret.shrink = shrink;
+        ret.charge = {};
+        ret.pixels = Buffer<uint32_t>{ *ctx.pool, (qint64)ret.width * (qint64)ret.height };
+        ret.charge = MemoryCharge{ ctx.account, MemoryAccount::ePixels, ret.pixels.size() * (qint64)sizeof( uint32_t ) };
+        return !ret.pixels.empty();
+    };
+    ret.colorspace = layout.colorspace;
+    if ( !allocatePixels() ) {
+        LOG( "Failed to allocate pixel buffer" );
+        return {};
+    }
+
+    const qint64 offset = static_cast<qint64>( layout.offset );
+    const qint64 totalBytes = static_cast<qint64>( layout.bytes() );
+    trace.arg( "format", dds::name( layout.codec ) );
+    trace.arg( "width", layout.oWidth );
+    trace.arg( "height", layout.oHeight );
+    trace.arg( "mip", layout.mip );
+    trace.arg( "shrink", shrink );
+    trace.arg( "sampled", sampled );
+    trace.arg( "bytesRead", totalBytes );
+    if ( file->pos() != offset && !file->seek( offset ) ) {
+        LOG( "Seek failed" );
+        return {};
+    }
+
+    const size_t stride = layout.width * sizeof( uint32_t );
+    // NOTE: tightly packed ARGB needs no conversion, read straight into place
+    if ( shrink == 1 && layout.codec == dds::Codec::eB8G8R8A8 && layout.rowPitch == stride ) {
+        TraceScope read{ "read" };
+        read.arg( "bytes", totalBytes );
+        if ( file->read( reinterpret_cast<char*>( ret.pixels.data() ), totalBytes ) != totalBytes ) {
+            LOG( "File truncated or corrupted, not enough data to read" );
+            return {};
+        }
+        return ret;
+    }
+
+    const qint64 rowPitch = static_cast<qint64>( layout.rowPitch );
+    const qint64 bandRows = bandRowsFor( layout, shrink );
+    const uint64_t unit = unitBytes( layout );
+
+    // NOTE: when averaging, bands are decoded at full size into scratch and reduced from there,
+    //       when sampling, picked blocks or texels of a stored row are gathered and decoded as one short row
+    Buffer<uint32_t> reduceScratch{};
+    Buffer<uint8_t> gather{};
+    Buffer<uint32_t> sampleScratch{};
+    MemoryCharge scratchCharge{};
+    auto allocateScratch = [&]()
+    {
+        scratchCharge = {};
+        reduceScratch = {};
+        if ( sampled ) {
+            gather = Buffer<uint8_t>{ *ctx.pool, (qint64)ret.width * (qint64)unit };
+            sampleScratch = Buffer<uint32_t>{ *ctx.pool, (qint64)ret.width * layout.texelsPerRow * layout.texelsPerRow };
+            scratchCharge = MemoryCharge{ ctx.account, MemoryAccount::eReduceBand, gather.size() + sampleScratch.size() * (qint64)sizeof( uint32_t ) };
+            return !gather.empty() && !sampleScratch.empty();
+        }
+        if ( shrink > 1 ) {
+            reduceScratch = Buffer<uint32_t>{ *ctx.pool, bandRows * layout.texelsPerRow * layout.width };
+            scratchCharge = MemoryCharge{ ctx.account, MemoryAccount::eReduceBand, reduceScratch.size() * (qint64)sizeof( uint32_t ) };
+            return !reduceScratch.empty();
+        }
+        return true;
+    };
+    if ( !allocateScratch() ) {
+        LOG( "Failed to allocate decode scratch" );
+        return {};
+    }
+
+    dds::Layout sampleLayout = layout;
+    auto decodeSampled = [&]( const uint8_t* data, qint64 firstRow, qint64 rows, dds::DecodeStats* stats )
+    {
+        const uint32_t step = sampleStep( layout, shrink );
+        sampleLayout.width = sampleLayout.oWidth = ret.width * layout.texelsPerRow;
+        sampleLayout.height = sampleLayout.oHeight = layout.texelsPerRow;
+        sampleLayout.rowPitch = ret.width * unit;
+        sampleLayout.rowCount = 1;
+        bool rowsOk = true;
+        for ( qint64 r = ( firstRow + step - 1 ) / step * step; r < firstRow + rows; r += step ) {
+            const uint8_t* src = data + ( r - firstRow ) * rowPitch;
+            for ( uint32_t i = 0; i < ret.width; ++i ) {
+                std::memcpy( gather.data() + i * unit, src + (uint64_t)i * step * unit, unit );
+            }
+            const dds::Span<const uint8_t> row{ gather.data(), static_cast<size_t>( sampleLayout.rowPitch ) };
+            uint32_t* dst = ret.pixels.data() + ( r / step ) * ret.width;
+            if ( layout.texelsPerRow == 1 ) {
+                rowsOk &= dds::decodeRows( sampleLayout, row, dst, ret.width * sizeof( uint32_t ), stats );
+                continue;
+            }
+            rowsOk &= dds::decodeRows( sampleLayout, row, sampleScratch.data(), sampleLayout.width * sizeof( uint32_t ), stats );
+            reduceBand( sampleScratch.data(), sampleLayout.width, layout.texelsPerRow, layout.texelsPerRow, dst, ret.width );
+        }
+        return rowsOk;
+    };
+
+    // NOTE: averages rows decoded so far down to the new shrink, sampled rows continue from where it ends
+    auto degrade = [&]( uint32_t newShrink, qint64 rowsDone )
+    {
+        TraceScope degraded{ "degrade" };
+        degraded.arg( "shrink", newShrink );
+        degraded.arg( "rowsDone", rowsDone );
+        const uint32_t oldShrink = shrink;
+        const uint32_t oldWidth = ret.width;
+        const uint32_t decodedRows = shrunk( static_cast<uint32_t>( std::min<qint64>( rowsDone * layout.texelsPerRow, layout.height ) ), oldShrink );
+        Buffer<uint32_t> oldPixels = std::move( ret.pixels );
+        MemoryCharge oldCharge = std::move( ret.charge );
+        shrink = newShrink;
+        sampled = true;
+        if ( !allocatePixels() || !allocateScratch() ) return false;
+        reduceBand( oldPixels.data(), oldWidth, decodedRows, newShrink / oldShrink, ret.pixels.data(), ret.width );
+        LOG( "Decode behind deadline, continuing sampled at 1/" + std::to_string( newShrink ) );
+        return true;
+    };
+
+    const auto decodeBegin = std::chrono::steady_clock::now();
+    dds::DecodeStats stats{};
+    qint64 row = 0;
+    bool ok = true;
+    auto consume = [&]( const char* data, qint64 bytes )
+    {
+        TraceScope decode{ "decodeRows" };
+        decode.arg( "rows", bytes / rowPitch );
+        const dds::Span<const uint8_t> span{ reinterpret_cast<const uint8_t*>( data ), static_cast<size_t>( bytes ) };
+        const qint64 firstRow = row;
+        const qint64 texelRow = row * layout.texelsPerRow;
+        row += bytes / rowPitch;
+        if ( sampled ) {
+            ok &= decodeSampled( span.data(), firstRow, bytes / rowPitch, &stats );
+            return;
+        }
+        if ( shrink == 1 ) {
+            ok &= dds::decodeRows( layout, span, ret.pixels.data() + texelRow * layout.width, stride, &stats );
+        }
+        else {
+            ok &= dds::decodeRows( layout, span, reduceScratch.data(), stride, &stats );
+            const uint32_t texelRows = static_cast<uint32_t>( std::min<qint64>( row * layout.texelsPerRow, layout.height ) - texelRow );
+            reduceBand( reduceScratch.data(), layout.width, texelRows, shrink, ret.pixels.data() + ( texelRow / shrink ) * ret.width, ret.width );
+        }
+
+        // NOTE: checkpoint, linear projection of the rows left from the pace so far
+        const qint64 rowsLeft = static_cast<qint64>( layout.rowCount ) - row;
+        if ( !ok || ctx.budget.count() <= 0 || rowsLeft <= 0 || layout.tiling != dds::Tiling::eLinear ) return;
+        const auto now = std::chrono::steady_clock::now();
+        const double leftNs = std::chrono::duration<double, std::nano>( now - decodeBegin ).count() * rowsLeft / row;
+        const double remainingNs = std::chrono::duration<double, std::nano>( ctx.deadline - now ).count();
+        if ( now + std::chrono::nanoseconds( static_cast<qint64>( leftNs ) ) <= ctx.deadline ) return;
+
+        // NOTE: past the deadline already, aim to finish within a tenth of the budget
+        const double availableNs = std::max( remainingNs, ctx.budget.count() * 0.1 );
+        uint32_t step = 2;
+        while ( step * step < leftNs / availableNs ) step *= 2;
+        uint32_t newShrink = std::max( shrink, layout.texelsPerRow ) * 2;
+        while ( newShrink < step * layout.texelsPerRow && shrunk( std::max( layout.width, layout.height ), newShrink * 2 ) >= MIN_DEGRADED_EXTENT ) {
+            newShrink *= 2;
+        }
+        ok &= degrade( newShrink, row );
+    };
+
+    QFileDevice* fileDevice = qobject_cast<QFileDevice*>( file );
+    if ( sampled && sampleStep( layout, shrink ) > 1 ) {
+        // NOTE: planned sampling, skip stored rows it won't decode with forward seeks
+        TraceScope read{ "sampledRows" };
+        Buffer<char> stored{ *ctx.pool, rowPitch };
+        if ( stored.empty() ) {
+            LOG( "Failed to allocate read band" );
+            return {};
+        }
+        const MemoryCharge storedCharge{ ctx.account, MemoryAccount::eReadBand, stored.size() };
+        const qint64 step = sampleStep( layout, shrink );
+        for ( qint64 r = 0; ok && r < static_cast<qint64>( layout.rowCount ); r += step ) {
+            if ( !file->seek( offset + r * rowPitch ) || file->read( stored.data(), rowPitch ) != rowPitch ) {
+                LOG( "File truncated or corrupted, not enough data to read" );
+                return {};
+            }
+            ok &= decodeSampled( reinterpret_cast<const uint8_t*>( stored.data() ), r, 1, &stats );
+        }
+        read.arg( "rows", ( static_cast<qint64>( layout.rowCount ) + step - 1 ) / step );
+    }
+    else if ( ctx.readerThread && fileDevice && fileDevice->handle() >= 0 && estimateDecodeNs( layout, shrink, false, ctx.costs ) >= PIPELINE_MIN_NS ) {
+        // NOTE: slow to decode plain files, overlap reading next band of rows with decoding current one
+        ok &= readOverlapped( fileDevice->handle(), offset, totalBytes, bandRows * rowPitch, *ctx.pool, ctx.account, consume );
+    }
+    else {
+        Buffer<char> band{ *ctx.pool, std::min( bandRows * rowPitch, totalBytes ) };
+        if ( band.empty() ) {
+            LOG( "Failed to allocate read band" );
+            return {};
+        }
+        const MemoryCharge bandCharge{ ctx.account, MemoryAccount::eReadBand, band.size() };
+        for ( qint64 done = 0; ok && done < totalBytes; ) {
+            const qint64 bytes = std::min<qint64>( band.size(), totalBytes - done );
+            {
+                TraceScope read{ "read" };
+                read.arg( "bytes", bytes );
+                if ( file->read( band.data(), bytes ) != bytes ) {
+                    LOG( "File truncated or corrupted, not enough data to read" );
+                    return {};
+                }
+            }
+            consume( band.data(), bytes );
+            done += bytes;
+        }
+    }
+    if ( !ok ) {
+        return {};
+    }
+
+    if ( stats.blocks ) {
+        LOG( std::string( dds::name( layout.codec ) )
+            + " blocks: " + std::to_string( stats.blocks )
+            + ", uniform: " + std::to_string( stats.uniform )
+            + ", repeated: " + std::to_string( stats.repeated ) );
+        trace.arg( "blocks", stats.blocks );
+        trace.arg( "uniform", stats.uniform );
+        trace.arg( "repeated", stats.repeated );
+    }
+    if ( layout.codec == dds::Codec::eBC7 ) {
+        trace.arg( "bc7Modes", stats.bc7Modes, std::size( stats.bc7Modes ) );
+    }
+    trace.arg( "finalShrink", ret.shrink );
+    return ret;
+}
+
+// NOTE: returned image references data.pixels unless cropped
+inline QImage toImage( const ImageData& data )
+{
+    assert( data.width );
+    assert( data.height );
+
+    QImage image{ reinterpret_cast<const uchar*>( data.pixels.data() )
+        , static_cast<int>( data.width )
+        , static_cast<int>( data.height )
+        , QImage::Format_ARGB32
+        , nullptr // non-owning qimage
+        , nullptr
+    };
+
+    {
+        TraceScope trace{ "colorspace" };
+        switch ( data.colorspace ) {
+        // also treat unorms as srgb for better visuals?
+        case Colorspace::eUNORM: image.setColorSpace( QColorSpace::SRgb ); break;
+        case Colorspace::eSRGB: image.setColorSpace( QColorSpace::SRgb ); break;
+        }
+    }
+
+    if ( data.extentNeedsResize ) {
+        assert( data.oWidth );
+        assert( data.oHeight );
+        TraceScope trace{ "crop" };
+        trace.arg( "width", data.oWidth );
+        trace.arg( "height", data.oHeight );
+        image = image.copy( 0, 0, data.oWidth, data.oHeight );
+    }
+    return image;
+}
+
+// NOTE: in case of
+// large image + scaling = jagged thumbnail
+// small image + no-scaling = blurry thumbnail
+// smooth filter is picked by the thumbnailer profile, linear light filtering goes through 16 bit per channel
+// so that dark tones survive the transfer function, and returns to 8 bit sRGB afterwards
+inline QImage scaleThumbnail( const QImage& image, const QSize& target, Qt::TransformationMode filter = Qt::FastTransformation, bool linearLight = false )
+{
+    TraceScope trace{ "scale" };
+    trace.arg( "width", image.width() );
+    trace.arg( "height", image.height() );
+    trace.arg( "targetWidth", target.width() );
+    trace.arg( "targetHeight", target.height() );
+    trace.arg( "smooth", filter == Qt::SmoothTransformation );
+    const QSize scaledSize = image.size().scaled( target, Qt::KeepAspectRatio );
+    if ( !linearLight || filter != Qt::SmoothTransformation || scaledSize == image.size() ) {
+        return image.scaled( target.width(), target.height(), Qt::KeepAspectRatio, filter );
+    }
+
+    trace.arg( "linearLight", true );
+    QImage linear = image.convertToFormat( QImage::Format_RGBA64 );
+    linear.setColorSpace( QColorSpace::SRgb );
+    linear.convertToColorSpace( QColorSpace::SRgbLinear );
+    QImage ret = linear.scaled( scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+    ret.convertToColorSpace( QColorSpace::SRgb );
+    return ret.convertToFormat( QImage::Format_ARGB32 );
+}
+
+} // namespace
@@ -0,0 +1,161 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// KFileMetaData extractor, fills Dolphin's information panel and Baloo index with DDS properties.
+// Only the header is read, a single read of at most dds::MAX_HEADER_BYTES per file, pixel data is never touched.
+
+#include <KFileMetaData/ExtractionResult>
+#include <KFileMetaData/ExtractorPlugin>
+#include <KFileMetaData/Properties>
+#include <QFile>
+#include <QStringList>
+
+#include "ddsdecode.hpp"
+#include "ddsformat.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+using dds::DDSHeader;
+using dds::DXGIHeader;
+using dds::PixelFormat;
+using dds::XBOXHeader;
+
+// NOTE: header fields as stored, unlike dds::Layout which only counts what the decoder can locate
+struct Summary {
+    uint32_t mipCount = 1;
+    uint32_t arraySize = 1; // array elements, whole cubes for cube arrays
+    uint32_t faces = 0; // of each cube, 0 for other textures
+    uint32_t depth = 1;
+};
+
+static Summary summarize( const uint8_t* bytes, size_t size )
+{
+    Summary ret{};
+    DDSHeader header{};
+    std::memcpy( &header, bytes, sizeof( header ) );
+    if ( ( header.flags & DDSHeader::fMipMapCount ) && header.mipMapCount ) {
+        ret.mipCount = header.mipMapCount;
+    }
+    if ( header.caps2 & DDSHeader::fVolume ) {
+        ret.depth = std::max( header.depth, 1u );
+    }
+    if ( header.caps2 & DDSHeader::fCubemap ) {
+        ret.faces = std::max( (uint32_t)__builtin_popcount( header.caps2 & DDSHeader::fCubemapFaces ), 1u );
+    }
+
+    // NOTE: both extensions store the array size and texture cube flag the same way, only DXGI format offsets differ
+    auto extension = [&]( uint32_t arraySize, uint32_t flags )
+    {
+        ret.faces = flags & DXGIHeader::fTextureCube ? 6 : 0;
+        ret.arraySize = std::max( arraySize, 1u );
+    };
+    const bool fourCC = header.pixelFormat.flags == PixelFormat::fFourCC;
+    if ( fourCC && header.pixelFormat.fourCC == '01XD' && size >= sizeof( DDSHeader ) + sizeof( DXGIHeader ) ) {
+        DXGIHeader dxgi{};
+        std::memcpy( &dxgi, bytes + sizeof( DDSHeader ), sizeof( dxgi ) );
+        extension( dxgi.arraySize, dxgi.flags );
+    }
+    else if ( fourCC && header.pixelFormat.fourCC == 'XOBX' && size >= sizeof( DDSHeader ) + sizeof( XBOXHeader ) ) {
+        XBOXHeader xbox{};
+        std::memcpy( &xbox, bytes + sizeof( DDSHeader ), sizeof( xbox ) );
+        extension( xbox.arraySize, xbox.flags );
+    }
+    return ret;
+}
+
+// NOTE: e.g. "BC7 sRGB, 10 mip levels, 6 faces" or "BC1, 4 cubes", there is no dedicated property for texture layout
+static QString describe( const dds::Layout& layout, const Summary& summary )
+{
+    QString ret = QString::fromLatin1( dds::name( layout.codec ) );
+    if ( layout.colorspace == dds::Colorspace::eSRGB ) {
+        ret += QStringLiteral( " sRGB" );
+    }
+    if ( summary.mipCount > 1 ) {
+        ret += QStringLiteral( ", %1 mip levels" ).arg( summary.mipCount );
+    }
+    if ( summary.depth > 1 ) {
+        ret += QStringLiteral( ", %1 slices" ).arg( summary.depth );
+    }
+    if ( summary.faces && summary.arraySize > 1 ) {
+        ret += QStringLiteral( ", %1 cubes" ).arg( summary.arraySize );
+    }
+    else if ( summary.faces ) {
+        ret += QStringLiteral( ", %1 faces" ).arg( summary.faces );
+    }
+    else if ( summary.arraySize > 1 ) {
+        ret += QStringLiteral( ", %1 array elements" ).arg( summary.arraySize );
+    }
+    return ret;
+}
+
+} // namespace
+
+class DDSExtractor : public KFileMetaData::ExtractorPlugin
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA( IID kfilemetadata_extractor_iid FILE "ddsextractor.json" )
+    Q_INTERFACES( KFileMetaData::ExtractorPlugin )
+
+public:
+    explicit DDSExtractor( QObject* parent = nullptr )
+        : KFileMetaData::ExtractorPlugin( parent )
+    {
+    }
+
+    QStringList mimetypes() const override
+    {
+        return { QStringLiteral( "image/x-dds" ) };
+    }
+
+    void extract( KFileMetaData::ExtractionResult* result ) override;
+};
+
+void DDSExtractor::extract( KFileMetaData::ExtractionResult* result )
+{
+    result->addType( KFileMetaData::Type::Image );
+    if ( !( result->inputFlags() & KFileMetaData::ExtractionResult::ExtractMetaData ) ) return;
+
+    QFile file{ result->inputUrl() };
+    if ( !file.open( QIODevice::ReadOnly ) ) return;
+
+    uint8_t bytes[ dds::MAX_HEADER_BYTES ]{};
+    const qint64 size = file.read( reinterpret_cast<char*>( bytes ), sizeof( bytes ) );
+    if ( size < static_cast<qint64>( sizeof( DDSHeader ) ) ) return;
+
+    // NOTE: pixel data is still validated against the file size, truncated files report nothing,
+    //       textures too large to thumbnail still have their metadata
+    dds::Layout layout{};
+    if ( !dds::inspectLayout( dds::Span<const uint8_t>{ bytes, static_cast<size_t>( size ) }, static_cast<uint64_t>( file.size() ), layout ) ) {
+        return;
+    }
+
+    const Summary summary = summarize( bytes, static_cast<size_t>( size ) );
+    result->add( KFileMetaData::Property::Width, layout.oWidth );
+    result->add( KFileMetaData::Property::Height, layout.oHeight );
+    result->add( KFileMetaData::Property::Description, describe( layout, summary ) );
+}
+
+#include "ddsextractor.moc"
@@ -0,0 +1,173 @@
+// MIT License
+//
+// Copyright (c) 2022 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// On-disk structures of DDS files
+// https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+// https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-pixelformat
+// https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header-dxt10
+// https://github.com/microsoft/DirectXTex/blob/main/Auxiliary/DirectXTexXbox.h
+
+#pragma once
+
+#include <cstdint>
+
+namespace dds {
+
+struct PixelFormat {
+    enum Flags : uint32_t {
+        fAlphaPixels = 0x1,
+        fAlpha = 0x2,
+        fFourCC = 0x4,
+        fRGB = 0x40,
+        fYUV = 0x200,
+        fLuminance = 0x20000,
+    };
+
+    uint32_t size = 0;
+    Flags flags = {};
+    uint32_t fourCC = 0;
+    uint32_t rgbBitCount = 0;
+    uint32_t bitmaskR = 0;
+    uint32_t bitmaskG = 0;
+    uint32_t bitmaskB = 0;
+    uint32_t bitmaskA = 0;
+};
+static_assert( sizeof( PixelFormat ) == 32 );
+
+struct DDSHeader {
+    enum Flags : uint32_t {
+        fCaps = 0x1,
+        fHeight = 0x2,
+        fWidth = 0x4,
+        fPitch = 0x8,
+        fPixelFormat = 0x1000,
+        fMipMapCount = 0x20000,
+        fLinearSize = 0x80000,
+        fDepth = 0x800000,
+    };
+    enum Caps : uint32_t {
+        fComplex = 0x8,
+        fMipMap = 0x400000,
+        fTexture = 0x1000,
+    };
+    enum Caps2 : uint32_t {
+        fCubemap = 0x200,
+        fCubemapFaces = 0xFC00,
+        fVolume = 0x200000,
+    };
+
+    static constexpr uint32_t MAGIC = ' SDD';
+    static constexpr uint32_t SIZE = 124;
+
+    uint32_t magic = 0;
+    uint32_t size = 0;
+    Flags flags = {};
+    uint32_t height = 0;
+    uint32_t width = 0;
+    uint32_t pitchOrLinearSize = 0;
+    uint32_t depth = 0;
+    uint32_t mipMapCount = 0;
+    uint32_t reserved[ 11 ]{};
+    PixelFormat pixelFormat{};
+    Caps caps{};
+    uint32_t caps2 = 0;
+    uint32_t caps3 = 0;
+    uint32_t caps4 = 0;
+    uint32_t reserved2 = 0;
+};
+static_assert( sizeof( DDSHeader ) == 128 );
+
+enum Format : uint32_t {
+    DXGI_FORMAT_R8_UNORM = 61,
+
+    DXGI_FORMAT_BC1_TYPELESS = 70,
+    DXGI_FORMAT_BC1_UNORM = 71,
+    DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+
+    DXGI_FORMAT_BC2_TYPELESS = 73,
+    DXGI_FORMAT_BC2_UNORM = 74,
+    DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+
+    DXGI_FORMAT_BC3_TYPELESS = 76,
+    DXGI_FORMAT_BC3_UNORM = 77,
+    DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+
+    DXGI_FORMAT_BC4_TYPELESS = 79,
+    DXGI_FORMAT_BC4_UNORM = 80,
+    DXGI_FORMAT_BC4_UNORM_SRGB = 81,
+
+    DXGI_FORMAT_BC5_TYPELESS = 82,
+    DXGI_FORMAT_BC5_UNORM = 83,
+    DXGI_FORMAT_BC5_UNORM_SRGB = 84,
+
+    DXGI_FORMAT_B5G6R5_UNORM = 85,
+    DXGI_FORMAT_B5G5R5A1_UNORM = 86,
+    DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+
+    DXGI_FORMAT_BC7_TYPELESS = 97,
+    DXGI_FORMAT_BC7_UNORM = 98,
+    DXGI_FORMAT_BC7_UNORM_SRGB = 99,
+
+    DXGI_FORMAT_B4G4R4A4_UNORM = 115,
+};
+
+struct DXGIHeader {
+    enum Dimension : uint32_t {
+        eTexture1D = 2,
+        eTexture2D = 3,
+        eTexture3D = 4,
+    };
+    enum Flags : uint32_t {
+        fTextureCube = 0x4,
+    };
+
+    uint32_t format = 0;
+    uint32_t dimension = 0;
+    uint32_t flags = 0;
+    uint32_t arraySize = 0;
+    uint32_t flags2 = 0;
+};
+static_assert( sizeof( DXGIHeader ) == 20 );
+
+// NOTE: follows DDSHeader when fourCC is XBOX, Xbox One titles export it with pixel data in GPU tiled layout.
+//       Tile modes are the Xbox One XG_TILE_MODE values, Series X|S swizzle modes are not handled
+struct XBOXHeader {
+    enum TileMode : uint32_t {
+        eLinear = 8, // rows padded to pipe interleave, not tiled
+        eDisplay1D = 9, // 8x8 micro tiles, displayable element order
+        eThin1D = 13, // 8x8 micro tiles, Morton element order
+        eThin2D = 14, // micro tiles in bank and pipe swizzled macro tiles
+    };
+
+    uint32_t format = 0;
+    uint32_t dimension = 0;
+    uint32_t flags = 0;
+    uint32_t arraySize = 0;
+    uint32_t flags2 = 0;
+    uint32_t tileMode = 0;
+    uint32_t baseAlignment = 0;
+    uint32_t dataSize = 0;
+    uint32_t xdkVersion = 0;
+};
+static_assert( sizeof( XBOXHeader ) == 36 );
+
+} // namespace dds
@@ -0,0 +1,223 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Qt image format plugin, lets QImageReader users like Gwenview, Krita or Okular load DDS through the thumbnailer decoder.
+// Every mip level of every array element or cube face is an image of its own, numbered element by element,
+// so each one is read without touching the others.
+
+#include <QImageIOHandler>
+#include <QImageIOPlugin>
+#include <QVariant>
+
+#include "ddsdecoder.hpp"
+
+#include <climits>
+
+namespace {
+
+// NOTE: shared by handlers of the whole process, viewers open file after file
+static BufferPool& sharedPool()
+{
+    static BufferPool pool{ 64u << 20 };
+    return pool;
+}
+
+class DDSImageIOHandler : public QImageIOHandler
+{
+    // NOTE: parsed lazily, also from const queries
+    mutable dds::Layout m_top{};
+    mutable bool m_parsed = false;
+    mutable bool m_valid = false;
+    int m_index = 0;
+    QSize m_scaledSize{};
+
+    // NOTE: header is read once, layouts hold offsets from the start of the device
+    bool parse() const
+    {
+        if ( m_parsed ) return m_valid;
+        m_parsed = true;
+        QIODevice* file = device();
+        if ( !file || file->pos() != 0 ) {
+            LOG( "Device not positioned at the DDS header" );
+            return false;
+        }
+        m_valid = readLayout( file, QSize{}, m_top );
+        return m_valid;
+    }
+
+    bool locate( int index, dds::Layout& layout ) const
+    {
+        if ( !parse() || index < 0 || index >= imageCount() ) return false;
+        const uint64_t fileSize = static_cast<uint64_t>( device()->size() );
+        const uint32_t element = static_cast<uint32_t>( index ) / m_top.mipCount;
+        const uint32_t level = static_cast<uint32_t>( index ) % m_top.mipCount;
+        dds::Layout top{};
+        return dds::elementLayout( m_top, element, fileSize, top )
+            && dds::mipLayout( top, level, fileSize, layout );
+    }
+
+    // NOTE: smallest mip still covering the scaled size, then averaged down by a power of two as far as it stays covered,
+    //       what is left is scaled exactly by Qt from at most twice the size asked for
+    void planScaled( dds::Layout& layout, DecodeContext& ctx ) const
+    {
+        const uint32_t width = static_cast<uint32_t>( m_scaledSize.width() );
+        const uint32_t height = static_cast<uint32_t>( m_scaledSize.height() );
+        const uint64_t fileSize = static_cast<uint64_t>( device()->size() );
+        while ( layout.mipCount > 1 ) {
+            dds::Layout next{};
+            if ( !dds::mipLayout( layout, 1, fileSize, next ) ) break;
+            if ( next.oWidth < width || next.oHeight < height ) break;
+            layout = next;
+        }
+        while ( shrunk( layout.oWidth, ctx.shrink * 2 ) >= width && shrunk( layout.oHeight, ctx.shrink * 2 ) >= height ) {
+            ctx.shrink *= 2;
+        }
+    }
+
+public:
+    DDSImageIOHandler() = default;
+    ~DDSImageIOHandler() override = default;
+
+    static bool canRead( QIODevice* device )
+    {
+        if ( !device ) return false;
+        return device->peek( 4 ) == QByteArrayLiteral( "DDS " );
+    }
+
+    // NOTE: once the header is parsed the device is no longer at its start, images left are counted instead
+    bool canRead() const override
+    {
+        if ( m_parsed ) return m_valid && m_index < imageCount();
+        if ( !canRead( device() ) ) return false;
+        setFormat( QByteArrayLiteral( "dds" ) );
+        return true;
+    }
+
+    bool read( QImage* image ) override
+    {
+        dds::Layout layout{};
+        if ( !locate( m_index, layout ) ) return false;
+
+        DecodeContext ctx{};
+        ctx.pool = &sharedPool();
+        const bool scaled = m_scaledSize.isValid() && !m_scaledSize.isEmpty();
+        if ( scaled ) {
+            ctx.target = m_scaledSize;
+            planScaled( layout, ctx );
+        }
+
+        const ImageData data = decodeImage( layout, device(), ctx );
+        if ( data.pixels.empty() ) return false;
+
+        QImage ret = toImage( data );
+        if ( scaled && ret.size() != m_scaledSize ) {
+            ret = ret.scaled( m_scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+        }
+        // NOTE: detach before pixels go back to the pool
+        if ( ret.constBits() == reinterpret_cast<const uchar*>( data.pixels.data() ) ) {
+            ret = ret.copy( 0, 0, ret.width(), ret.height() );
+        }
+        *image = ret;
+        m_index++;
+        return true;
+    }
+
+    bool supportsOption( ImageOption option ) const override
+    {
+        switch ( option ) {
+        case Size: [[fallthrough]];
+        case ScaledSize: [[fallthrough]];
+        case ImageFormat: return true;
+        default: return false;
+        }
+    }
+
+    QVariant option( ImageOption option ) const override
+    {
+        switch ( option ) {
+        case ScaledSize: return m_scaledSize;
+        case ImageFormat: return QImage::Format_ARGB32;
+        case Size: {
+            dds::Layout layout{};
+            if ( !locate( m_index, layout ) ) return {};
+            return QSize{ static_cast<int>( layout.oWidth ), static_cast<int>( layout.oHeight ) };
+        }
+        default: return {};
+        }
+    }
+
+    void setOption( ImageOption option, const QVariant& value ) override
+    {
+        if ( option == ScaledSize ) {
+            m_scaledSize = value.toSize();
+        }
+    }
+
+    int imageCount() const override
+    {
+        if ( !parse() ) return 0;
+        return static_cast<int>( std::min<uint64_t>( (uint64_t)m_top.elementCount * m_top.mipCount, INT_MAX ) );
+    }
+
+    int currentImageNumber() const override
+    {
+        return m_index;
+    }
+
+    bool jumpToImage( int imageNumber ) override
+    {
+        if ( imageNumber < 0 || imageNumber >= imageCount() ) return false;
+        m_index = imageNumber;
+        return true;
+    }
+
+    bool jumpToNextImage() override
+    {
+        return jumpToImage( m_index + 1 );
+    }
+};
+
+} // namespace
+
+class DDSImageIOPlugin : public QImageIOPlugin
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA( IID QImageIOHandlerFactoryInterface_iid FILE "ddsimageio.json" )
+
+public:
+    Capabilities capabilities( QIODevice* device, const QByteArray& format ) const override
+    {
+        if ( format == "dds" ) return CanRead;
+        if ( !format.isEmpty() || !device || !device->isReadable() ) return {};
+        return DDSImageIOHandler::canRead( device ) ? CanRead : Capabilities{};
+    }
+
+    QImageIOHandler* create( QIODevice* device, const QByteArray& format ) const override
+    {
+        QImageIOHandler* handler = new DDSImageIOHandler{};
+        handler->setDevice( device );
+        handler->setFormat( format );
+        return handler;
+    }
+};
+
+#include "ddsimageio.moc"
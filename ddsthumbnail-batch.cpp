@@ -0,0 +1,583 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Pre-generates freedesktop thumbnails for DDS files using the thumbnailer decoders
+// https://specifications.freedesktop.org/thumbnail-spec/latest/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+
+#include <poll.h>
+#include <sched.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "compresseddevice.hpp"
+#include "ddsdecoder.hpp"
+
+namespace {
+
+struct ThumbnailSize {
+    const char* name;
+    int size;
+};
+
+constexpr ThumbnailSize THUMBNAIL_SIZES[] = {
+    { "normal", 128 },
+    { "large", 256 },
+    { "x-large", 512 },
+    { "xx-large", 1024 },
+};
+
+// NOTE: every worker owns a queue, pops from its front and steals from the back of others when empty
+class WorkStealingPool {
+    struct Queue {
+        std::mutex mutex{};
+        std::deque<QString> jobs{};
+    };
+
+    std::function<void( const QString& )> m_fn{};
+    std::vector<std::unique_ptr<Queue>> m_queues{};
+    std::vector<std::thread> m_threads{};
+    std::mutex m_mutex{};
+    std::condition_variable m_wake{};
+    std::atomic<size_t> m_queued = 0;
+    size_t m_next = 0;
+    bool m_closed = false;
+
+    bool tryPop( size_t self, QString& job )
+    {
+        const size_t count = m_queues.size();
+        for ( size_t i = 0; i < count; ++i ) {
+            Queue& queue = *m_queues[ ( self + i ) % count ];
+            std::lock_guard<std::mutex> lock{ queue.mutex };
+            if ( queue.jobs.empty() ) continue;
+            if ( i == 0 ) {
+                job = std::move( queue.jobs.front() );
+                queue.jobs.pop_front();
+            }
+            else {
+                job = std::move( queue.jobs.back() );
+                queue.jobs.pop_back();
+            }
+            m_queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void run( size_t self )
+    {
+        for ( ;; ) {
+            QString job{};
+            if ( tryPop( self, job ) ) {
+                m_fn( job );
+                continue;
+            }
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            if ( m_closed && m_queued == 0 ) return;
+            m_wake.wait( lock, [this]{ return m_closed || m_queued > 0; } );
+        }
+    }
+
+public:
+    WorkStealingPool( size_t threadCount, std::function<void( const QString& )> fn )
+    : m_fn{ std::move( fn ) }
+    {
+        threadCount = std::max<size_t>( threadCount, 1 );
+        for ( size_t i = 0; i < threadCount; ++i ) {
+            m_queues.emplace_back( std::make_unique<Queue>() );
+        }
+        for ( size_t i = 0; i < threadCount; ++i ) {
+            m_threads.emplace_back( &WorkStealingPool::run, this, i );
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        finish();
+    }
+
+    void push( QString job )
+    {
+        Queue& queue = *m_queues[ m_next++ % m_queues.size() ];
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_queued++;
+        {
+            std::lock_guard<std::mutex> queueLock{ queue.mutex };
+            queue.jobs.emplace_back( std::move( job ) );
+        }
+        m_wake.notify_one();
+    }
+
+    void finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_closed = true;
+        }
+        m_wake.notify_all();
+        for ( std::thread& t : m_threads ) {
+            if ( t.joinable() ) t.join();
+        }
+    }
+};
+
+// NOTE: bounds memory of decodes in flight, a single job larger than the limit is still let through alone
+class MemoryBudget {
+    std::mutex m_mutex{};
+    std::condition_variable m_released{};
+    qint64 m_limit = 0;
+    qint64 m_inFlight = 0;
+
+public:
+    explicit MemoryBudget( qint64 limit )
+    : m_limit{ limit }
+    {}
+
+    void acquire( qint64 bytes )
+    {
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        m_released.wait( lock, [this, bytes]{ return m_inFlight == 0 || m_inFlight + bytes <= m_limit; } );
+        m_inFlight += bytes;
+    }
+
+    qint64 limit() const
+    {
+        return m_limit;
+    }
+
+    void release( qint64 bytes )
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_inFlight -= bytes;
+        }
+        m_released.notify_all();
+    }
+};
+
+struct Stats {
+    std::atomic<qint64> written = 0;
+    std::atomic<qint64> fresh = 0;
+    std::atomic<qint64> failed = 0;
+};
+
+struct Batch {
+    QString cacheDir{};
+    std::vector<ThumbnailSize> sizes{};
+    BufferPool* pool = nullptr;
+    MemoryBudget* budget = nullptr;
+    Stats* stats = nullptr;
+};
+
+static QString thumbnailPath( const QString& cacheDir, const ThumbnailSize& size, const QByteArray& uri )
+{
+    const QByteArray md5 = QCryptographicHash::hash( uri, QCryptographicHash::Md5 ).toHex();
+    return cacheDir + QLatin1Char( '/' ) + QLatin1String( size.name ) + QLatin1Char( '/' ) + QString::fromLatin1( md5 ) + QStringLiteral( ".png" );
+}
+
+static bool isFresh( const QString& path, qint64 mtime )
+{
+    if ( !QFile::exists( path ) ) return false;
+    QImageReader reader{ path, "png" };
+    return reader.text( QStringLiteral( "Thumb::MTime" ) ) == QString::number( mtime );
+}
+
+static bool writeThumbnail( QImage thumbnail, const QString& path, const QByteArray& uri, const QFileInfo& info )
+{
+    thumbnail.setText( QStringLiteral( "Thumb::URI" ), QString::fromUtf8( uri ) );
+    thumbnail.setText( QStringLiteral( "Thumb::MTime" ), QString::number( info.lastModified().toSecsSinceEpoch() ) );
+    thumbnail.setText( QStringLiteral( "Thumb::Size" ), QString::number( info.size() ) );
+    thumbnail.setText( QStringLiteral( "Software" ), QStringLiteral( "ddsthumbnail-batch" ) );
+
+    QSaveFile file{ path };
+    if ( !file.open( QIODevice::WriteOnly ) ) return false;
+    if ( !thumbnail.save( &file, "PNG" ) ) {
+        file.cancelWriting();
+        return false;
+    }
+    file.setPermissions( QFileDevice::ReadOwner | QFileDevice::WriteOwner );
+    return file.commit();
+}
+
+static void processFile( const Batch& batch, const QString& path )
+{
+    const QFileInfo info{ path };
+    const QByteArray uri = QUrl::fromLocalFile( info.absoluteFilePath() ).toEncoded();
+    const qint64 mtime = info.lastModified().toSecsSinceEpoch();
+
+    std::vector<ThumbnailSize> stale{};
+    for ( const ThumbnailSize& size : batch.sizes ) {
+        if ( !isFresh( thumbnailPath( batch.cacheDir, size, uri ), mtime ) ) {
+            stale.push_back( size );
+        }
+    }
+    if ( stale.empty() ) {
+        batch.stats->fresh++;
+        return;
+    }
+
+    const QSize target{ stale.back().size, stale.back().size };
+    std::unique_ptr<QIODevice> file = std::make_unique<QFile>( path );
+    if ( !file->open( QIODevice::ReadOnly ) ) {
+        batch.stats->failed++;
+        return;
+    }
+    file = openDecompressed( std::move( file ) );
+    dds::Layout layout{};
+    if ( !file || !readLayout( file.get(), target, layout ) ) {
+        batch.stats->failed++;
+        return;
+    }
+
+    // NOTE: same reduction as the thumbnailer's Balanced profile, a single job may take the whole budget
+    DecodeContext ctx{};
+    ctx.pool = batch.pool;
+    ctx.target = target;
+    const uint64_t fileSize = static_cast<uint64_t>( file->size() );
+    selectCoveringMip( layout, fileSize, target, 2 );
+    planDecode( layout, fileSize, batch.budget->limit(), ctx );
+    planCoveringShrink( layout, 2, false, ctx );
+
+    const qint64 estimate = estimateDecodeBytes( layout, ctx.shrink, ctx.sampled, target );
+    batch.budget->acquire( estimate );
+
+    bool ok = false;
+    {
+        ImageData data = decodeImage( layout, file.get(), ctx );
+        file->close();
+        if ( !data.pixels.empty() ) {
+            const QImage image = toImage( data );
+            ok = true;
+            for ( const ThumbnailSize& size : stale ) {
+                QImage thumbnail = scaleThumbnail( image, QSize{ size.size, size.size }, Qt::SmoothTransformation );
+                if ( thumbnail.constBits() == reinterpret_cast<const uchar*>( data.pixels.data() ) ) {
+                    thumbnail = thumbnail.copy( 0, 0, thumbnail.width(), thumbnail.height() );
+                }
+                ok &= writeThumbnail( thumbnail, thumbnailPath( batch.cacheDir, size, uri ), uri, info );
+            }
+        }
+    }
+    batch.budget->release( estimate );
+    ( ok ? batch.stats->written : batch.stats->failed )++;
+}
+
+// NOTE: applies to threads created afterwards, workers must be spawned after calling this
+static void lowerPriority()
+{
+    sched_param param{};
+    sched_setscheduler( 0, SCHED_IDLE, &param );
+    setpriority( PRIO_PROCESS, 0, 19 );
+#ifdef SYS_ioprio_set
+    constexpr int IOPRIO_WHO_PROCESS = 1;
+    constexpr int IOPRIO_CLASS_IDLE = 3;
+    constexpr int IOPRIO_CLASS_SHIFT = 13;
+    syscall( SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT );
+#endif
+}
+
+static const QStringList& ddsNameFilters()
+{
+    static const QStringList filters{ QStringLiteral( "*.dds" ), QStringLiteral( "*.dds.gz" ), QStringLiteral( "*.dds.zst" ) };
+    return filters;
+}
+
+static bool isDDS( const QString& path )
+{
+    return path.endsWith( QStringLiteral( ".dds" ), Qt::CaseInsensitive )
+        || path.endsWith( QStringLiteral( ".dds.gz" ), Qt::CaseInsensitive )
+        || path.endsWith( QStringLiteral( ".dds.zst" ), Qt::CaseInsensitive );
+}
+
+// NOTE: recursive inotify watch, changed files are reported once writes to them settle for DEBOUNCE
+class DirectoryWatcher {
+public:
+    static constexpr std::chrono::milliseconds DEBOUNCE{ 2000 };
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr uint32_t DIR_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+    int m_fd = -1;
+    QStringList m_roots{};
+    std::unordered_map<int, QString> m_dirs{};
+    std::unordered_map<std::string, Clock::time_point> m_pending{};
+
+    void touch( const QString& path )
+    {
+        m_pending[ path.toStdString() ] = Clock::now();
+    }
+
+    // NOTE: files may land in a new directory before its watch is added, so these are queued as well
+    void watchTree( const QString& root, bool queueFiles )
+    {
+        QStringList dirs{ root };
+        QDirIterator it{ root, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories };
+        while ( it.hasNext() ) {
+            dirs.push_back( it.next() );
+        }
+        for ( const QString& dir : dirs ) {
+            const int wd = inotify_add_watch( m_fd, QFile::encodeName( dir ).constData(), DIR_EVENTS );
+            if ( wd < 0 ) {
+                std::cerr << "Cannot watch " << dir.toStdString() << "\n";
+                continue;
+            }
+            m_dirs[ wd ] = dir;
+        }
+        if ( !queueFiles ) return;
+        QDirIterator files{ root, ddsNameFilters(), QDir::Files, QDirIterator::Subdirectories };
+        while ( files.hasNext() ) {
+            touch( files.next() );
+        }
+    }
+
+    void rescan()
+    {
+        for ( const auto& it : m_dirs ) {
+            inotify_rm_watch( m_fd, it.first );
+        }
+        m_dirs.clear();
+        for ( const QString& root : m_roots ) {
+            watchTree( root, true );
+        }
+    }
+
+    void readEvents()
+    {
+        alignas( inotify_event ) char buffer[ 16 * 1024 ];
+        const ssize_t length = read( m_fd, buffer, sizeof( buffer ) );
+        for ( ssize_t offset = 0; offset < length; ) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>( buffer + offset );
+            offset += static_cast<ssize_t>( sizeof( inotify_event ) + event->len );
+
+            if ( event->mask & IN_Q_OVERFLOW ) {
+                rescan();
+                return;
+            }
+            auto dir = m_dirs.find( event->wd );
+            if ( dir == m_dirs.end() ) continue;
+            if ( event->mask & ( IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED ) ) {
+                m_dirs.erase( dir );
+                continue;
+            }
+            if ( !event->len ) continue;
+
+            const QString path = dir->second + QLatin1Char( '/' ) + QFile::decodeName( event->name );
+            if ( event->mask & IN_ISDIR ) {
+                if ( event->mask & ( IN_CREATE | IN_MOVED_TO ) ) watchTree( path, true );
+                continue;
+            }
+            // NOTE: IN_CREATE alone only restarts debounce, content arrives with IN_CLOSE_WRITE
+            if ( isDDS( path ) ) touch( path );
+        }
+    }
+
+public:
+    explicit DirectoryWatcher( const QStringList& roots )
+    : m_fd{ inotify_init1( IN_CLOEXEC ) }
+    , m_roots{ roots }
+    {
+        if ( m_fd < 0 ) return;
+        for ( const QString& root : m_roots ) {
+            watchTree( root, false );
+        }
+    }
+
+    ~DirectoryWatcher()
+    {
+        if ( m_fd >= 0 ) close( m_fd );
+    }
+
+    DirectoryWatcher( const DirectoryWatcher& ) = delete;
+    DirectoryWatcher& operator = ( const DirectoryWatcher& ) = delete;
+
+    bool isValid() const
+    {
+        return m_fd >= 0;
+    }
+
+    // NOTE: blocks until some files settled, returns false if nothing is left to watch
+    bool wait( QStringList& settled )
+    {
+        while ( settled.isEmpty() ) {
+            if ( m_dirs.empty() ) return false;
+
+            int timeout = -1;
+            if ( !m_pending.empty() ) {
+                auto oldest = std::min_element( m_pending.begin(), m_pending.end(), []( const auto& a, const auto& b ) { return a.second < b.second; } );
+                const auto left = std::chrono::duration_cast<std::chrono::milliseconds>( oldest->second + DEBOUNCE - Clock::now() );
+                timeout = static_cast<int>( std::max<int64_t>( left.count(), 0 ) );
+            }
+
+            pollfd pfd{ m_fd, POLLIN, 0 };
+            const int ret = poll( &pfd, 1, timeout );
+            if ( ret < 0 && errno != EINTR ) return false;
+            if ( ret > 0 ) readEvents();
+
+            const auto now = Clock::now();
+            for ( auto it = m_pending.begin(); it != m_pending.end(); ) {
+                if ( now - it->second < DEBOUNCE ) {
+                    ++it;
+                    continue;
+                }
+                settled.push_back( QString::fromStdString( it->first ) );
+                it = m_pending.erase( it );
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    QCoreApplication app{ argc, argv };
+    QCoreApplication::setApplicationName( QStringLiteral( "ddsthumbnail-batch" ) );
+
+    QCommandLineParser parser{};
+    parser.setApplicationDescription( QStringLiteral( "Pre-generates freedesktop thumbnails for DDS files" ) );
+    parser.addHelpOption();
+    parser.addPositionalArgument( QStringLiteral( "paths" ), QStringLiteral( "Files or directories to walk recursively" ), QStringLiteral( "paths..." ) );
+    const QCommandLineOption jobsOption{ { QStringLiteral( "j" ), QStringLiteral( "jobs" ) }
+        , QStringLiteral( "Number of decode threads" )
+        , QStringLiteral( "count" )
+        , QString::number( std::max( 1u, std::thread::hardware_concurrency() ) ) };
+    const QCommandLineOption memoryOption{ { QStringLiteral( "m" ), QStringLiteral( "memory" ) }
+        , QStringLiteral( "Upper bound of memory used by decodes in flight, in MiB" )
+        , QStringLiteral( "mib" )
+        , QStringLiteral( "1024" ) };
+    const QCommandLineOption sizesOption{ { QStringLiteral( "s" ), QStringLiteral( "sizes" ) }
+        , QStringLiteral( "Comma separated thumbnail sizes: normal, large, x-large, xx-large" )
+        , QStringLiteral( "sizes" )
+        , QStringLiteral( "normal,large" ) };
+    const QCommandLineOption watchOption{ { QStringLiteral( "w" ), QStringLiteral( "watch" ) }
+        , QStringLiteral( "Keep running at idle priority, regenerating thumbnails of files changed under given directories" ) };
+    parser.addOption( jobsOption );
+    parser.addOption( memoryOption );
+    parser.addOption( sizesOption );
+    parser.addOption( watchOption );
+    parser.process( app );
+
+    const QStringList paths = parser.positionalArguments();
+    if ( paths.isEmpty() ) {
+        parser.showHelp( 1 );
+    }
+
+    const QString cacheDir = QStandardPaths::writableLocation( QStandardPaths::GenericCacheLocation ) + QStringLiteral( "/thumbnails" );
+    std::vector<ThumbnailSize> sizes{};
+    for ( const QString& name : parser.value( sizesOption ).split( QLatin1Char( ',' ), Qt::SkipEmptyParts ) ) {
+        auto it = std::find_if( std::begin( THUMBNAIL_SIZES ), std::end( THUMBNAIL_SIZES ), [&name]( const ThumbnailSize& s ) { return name == QLatin1String( s.name ); } );
+        if ( it == std::end( THUMBNAIL_SIZES ) ) {
+            std::cerr << "Unknown thumbnail size: " << name.toStdString() << "\n";
+            return 1;
+        }
+        const QString dir = cacheDir + QLatin1Char( '/' ) + QLatin1String( it->name );
+        QDir{}.mkpath( dir );
+        QFile::setPermissions( dir, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner );
+        sizes.push_back( *it );
+    }
+    if ( sizes.empty() ) {
+        std::cerr << "No thumbnail sizes selected\n";
+        return 1;
+    }
+    std::sort( sizes.begin(), sizes.end(), []( const ThumbnailSize& a, const ThumbnailSize& b ) { return a.size < b.size; } );
+
+    const bool watch = parser.isSet( watchOption );
+    if ( watch ) {
+        lowerPriority();
+    }
+
+    BufferPool pool{ 256u << 20 };
+    MemoryBudget budget{ static_cast<qint64>( std::max( parser.value( memoryOption ).toInt(), 1 ) ) << 20 };
+    Stats stats{};
+    const Batch batch{ cacheDir, sizes, &pool, &budget, &stats };
+
+    {
+        WorkStealingPool workers{ static_cast<size_t>( std::max( parser.value( jobsOption ).toInt(), 1 ) )
+            , [&batch]( const QString& path ) { processFile( batch, path ); } };
+
+        for ( const QString& path : paths ) {
+            const QFileInfo info{ path };
+            if ( info.isFile() ) {
+                workers.push( info.absoluteFilePath() );
+                continue;
+            }
+            QDirIterator it{ path, ddsNameFilters(), QDir::Files, QDirIterator::Subdirectories };
+            while ( it.hasNext() ) {
+                workers.push( it.next() );
+            }
+        }
+
+        if ( watch ) {
+            QStringList roots{};
+            for ( const QString& path : paths ) {
+                const QFileInfo info{ path };
+                if ( info.isDir() ) roots.push_back( info.absoluteFilePath() );
+            }
+            DirectoryWatcher watcher{ roots };
+            if ( !watcher.isValid() ) {
+                std::cerr << "Cannot initialize inotify\n";
+                return 1;
+            }
+            QStringList settled{};
+            while ( watcher.wait( settled ) ) {
+                for ( const QString& path : settled ) {
+                    workers.push( path );
+                }
+                settled.clear();
+            }
+        }
+    }
+
+    std::cout << "written: " << stats.written
+        << ", up to date: " << stats.fresh
+        << ", failed: " << stats.failed << "\n";
+    return stats.failed ? 2 : 0;
+}
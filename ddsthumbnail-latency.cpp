@@ -0,0 +1,341 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Replays DDS files through the thumbnail plugin loaded the same way KIO loads it,
+// timing every create() call end to end, results as JSON on stdout.
+// Cold runs drop each file from page cache before the request, warm runs read it in first.
+// Peak decode memory of each request comes from the plugin's DDSTHUMBNAIL_MEMORY_STATS report.
+
+#include <KIO/ThumbnailCreator>
+#include <KPluginFactory>
+#include <KPluginMetaData>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QUrl>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compresseddevice.hpp"
+#include "ddsdecode.hpp"
+#include "ddsformat.hpp"
+
+#ifndef DDSTHUMBNAIL_PLUGIN_PATH
+#define DDSTHUMBNAIL_PLUGIN_PATH ""
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Input {
+    QString path;
+    QString mimeType;
+    std::string format;
+};
+
+struct Memory {
+    int64_t peakLiveBytes = 0;
+    size_t shrunk = 0;
+
+    void add( const Memory& rhs )
+    {
+        peakLiveBytes = std::max( peakLiveBytes, rhs.peakLiveBytes );
+        shrunk += rhs.shrunk;
+    }
+};
+
+static QString mimeTypeOf( const QString& path )
+{
+    if ( path.endsWith( QStringLiteral( ".gz" ), Qt::CaseInsensitive ) ) return QStringLiteral( "image/x-gzdds" );
+    if ( path.endsWith( QStringLiteral( ".zst" ), Qt::CaseInsensitive ) ) return QStringLiteral( "image/x-zstddds" );
+    return QStringLiteral( "image/x-dds" );
+}
+
+// NOTE: codec the plugin ends up decoding, compressed files are tagged with their container
+static std::string formatOf( const QString& path )
+{
+    std::unique_ptr<QIODevice> file = std::make_unique<QFile>( path );
+    if ( !file->open( QIODevice::ReadOnly ) ) return "unreadable";
+    file = openDecompressed( std::move( file ) );
+    if ( !file ) return "invalid";
+    uint8_t bytes[ dds::MAX_HEADER_BYTES ]{};
+    const qint64 size = file->read( reinterpret_cast<char*>( bytes ), sizeof( bytes ) );
+    dds::Layout layout{};
+    if ( size < 0 || !dds::inspectLayout( dds::Span<const uint8_t>{ bytes, static_cast<size_t>( size ) }, static_cast<uint64_t>( file->size() ), layout ) ) return "invalid";
+    std::string ret = dds::name( layout.codec );
+    if ( path.endsWith( QStringLiteral( ".gz" ), Qt::CaseInsensitive ) ) ret += "+gzip";
+    if ( path.endsWith( QStringLiteral( ".zst" ), Qt::CaseInsensitive ) ) ret += "+zstd";
+    return ret;
+}
+
+// NOTE: dirty pages are not dropped, freshly written files are flushed first
+static void dropFromCache( const QString& path )
+{
+    const int fd = ::open( QFile::encodeName( path ).constData(), O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 ) return;
+    ::fdatasync( fd );
+    ::posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+    ::close( fd );
+}
+
+static void readIntoCache( const QString& path )
+{
+    const int fd = ::open( QFile::encodeName( path ).constData(), O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 ) return;
+    ::posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+    std::vector<char> buffer( 1u << 20 );
+    while ( ::read( fd, buffer.data(), buffer.size() ) > 0 ) {}
+    ::close( fd );
+}
+
+// NOTE: high water mark of the whole process so far, it never goes down between runs
+static long peakRssKiB()
+{
+    rusage usage{};
+    ::getrusage( RUSAGE_SELF, &usage );
+    return usage.ru_maxrss;
+}
+
+// NOTE: nearest rank, samples must be sorted
+static double percentile( const std::vector<double>& sorted, double p )
+{
+    if ( sorted.empty() ) return 0.0;
+    const size_t rank = static_cast<size_t>( std::ceil( p / 100.0 * sorted.size() ) );
+    return sorted[ std::clamp<size_t>( rank, 1, sorted.size() ) - 1 ];
+}
+
+static void printLatency( std::vector<double> samples )
+{
+    std::sort( samples.begin(), samples.end() );
+    std::printf( "\"p50Ms\": %.3f, \"p95Ms\": %.3f, \"p99Ms\": %.3f, \"maxMs\": %.3f"
+        , percentile( samples, 50.0 )
+        , percentile( samples, 95.0 )
+        , percentile( samples, 99.0 )
+        , samples.empty() ? 0.0 : samples.back() );
+}
+
+static int64_t reportValue( const QByteArray& line, const char* key )
+{
+    const int at = line.indexOf( key );
+    if ( at < 0 ) return 0;
+    return std::strtoll( line.constData() + at + std::strlen( key ), nullptr, 10 );
+}
+
+// NOTE: plugin appends one line per decoded request, pivot cache hits and failures write none
+static Memory readReports( QFile& reports )
+{
+    Memory ret{};
+    while ( !reports.atEnd() ) {
+        const QByteArray line = reports.readLine();
+        ret.peakLiveBytes = std::max( ret.peakLiveBytes, reportValue( line, "\"peakLiveBytes\":" ) );
+        ret.shrunk += reportValue( line, "\"shrink\":" ) > 1;
+    }
+    return ret;
+}
+
+static void printMemory( const Memory& memory )
+{
+    std::printf( ", \"peakLiveMiB\": %.3f, \"shrunk\": %zu", memory.peakLiveBytes / 1048576.0, memory.shrunk );
+}
+
+static std::vector<Input> collectInputs( const QStringList& paths )
+{
+    std::vector<Input> ret{};
+    auto add = [&ret]( const QString& path ) { ret.push_back( Input{ path, mimeTypeOf( path ), formatOf( path ) } ); };
+    for ( const QString& path : paths ) {
+        const QFileInfo info{ path };
+        if ( info.isFile() ) {
+            add( info.absoluteFilePath() );
+            continue;
+        }
+        QDirIterator it{ path, { QStringLiteral( "*.dds" ), QStringLiteral( "*.dds.gz" ), QStringLiteral( "*.dds.zst" ) }, QDir::Files, QDirIterator::Subdirectories };
+        while ( it.hasNext() ) {
+            add( it.next() );
+        }
+    }
+    std::sort( ret.begin(), ret.end(), []( const Input& a, const Input& b ) { return a.path < b.path; } );
+    return ret;
+}
+
+static KPluginMetaData pluginMetaData( const QString& path )
+{
+    if ( !path.isEmpty() ) return KPluginMetaData{ path };
+    return KPluginMetaData::findPluginById( QStringLiteral( "kf6/thumbcreator" ), QStringLiteral( "ddsthumbnail" ) );
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    QCoreApplication app{ argc, argv };
+    QCoreApplication::setApplicationName( QStringLiteral( "ddsthumbnail-latency" ) );
+
+    QCommandLineParser parser{};
+    parser.setApplicationDescription( QStringLiteral( "Measures latency of thumbnail requests served by the DDS thumbnail plugin" ) );
+    parser.addHelpOption();
+    parser.addPositionalArgument( QStringLiteral( "paths" ), QStringLiteral( "Files or directories to walk recursively" ), QStringLiteral( "paths..." ) );
+    const QCommandLineOption pluginOption{ { QStringLiteral( "p" ), QStringLiteral( "plugin" ) }
+        , QStringLiteral( "Plugin file to load, defaults to the one built alongside" )
+        , QStringLiteral( "file" )
+        , QStringLiteral( DDSTHUMBNAIL_PLUGIN_PATH ) };
+    const QCommandLineOption sizesOption{ { QStringLiteral( "s" ), QStringLiteral( "sizes" ) }
+        , QStringLiteral( "Comma separated target sizes in pixels" )
+        , QStringLiteral( "sizes" )
+        , QStringLiteral( "128,256,512,1024" ) };
+    const QCommandLineOption cacheOption{ { QStringLiteral( "c" ), QStringLiteral( "cache" ) }
+        , QStringLiteral( "Comma separated page cache states to measure: cold, warm" )
+        , QStringLiteral( "states" )
+        , QStringLiteral( "cold,warm" ) };
+    const QCommandLineOption repeatOption{ { QStringLiteral( "r" ), QStringLiteral( "repeat" ) }
+        , QStringLiteral( "Requests per file, size and cache state" )
+        , QStringLiteral( "count" )
+        , QStringLiteral( "3" ) };
+    parser.addOption( pluginOption );
+    parser.addOption( sizesOption );
+    parser.addOption( cacheOption );
+    parser.addOption( repeatOption );
+    parser.process( app );
+
+    const QStringList paths = parser.positionalArguments();
+    if ( paths.isEmpty() ) {
+        parser.showHelp( 1 );
+    }
+
+    std::vector<int> sizes{};
+    for ( const QString& size : parser.value( sizesOption ).split( QLatin1Char( ',' ), Qt::SkipEmptyParts ) ) {
+        const int value = size.toInt();
+        if ( value <= 0 ) {
+            std::cerr << "Invalid size: " << size.toStdString() << "\n";
+            return 1;
+        }
+        sizes.push_back( value );
+    }
+    std::vector<bool> coldStates{};
+    for ( const QString& state : parser.value( cacheOption ).split( QLatin1Char( ',' ), Qt::SkipEmptyParts ) ) {
+        if ( state != QLatin1String( "cold" ) && state != QLatin1String( "warm" ) ) {
+            std::cerr << "Unknown cache state: " << state.toStdString() << "\n";
+            return 1;
+        }
+        coldStates.push_back( state == QLatin1String( "cold" ) );
+    }
+    const int repeat = std::max( parser.value( repeatOption ).toInt(), 1 );
+
+    // NOTE: must be set before the plugin is instantiated, it reads the environment once
+    const QString reportPath = QDir::temp().filePath( QStringLiteral( "ddsthumbnail-latency-%1.jsonl" ).arg( QCoreApplication::applicationPid() ) );
+    QFile::remove( reportPath );
+    qputenv( "DDSTHUMBNAIL_MEMORY_STATS", QFile::encodeName( reportPath ) );
+    QFile reports{ reportPath };
+
+    const KPluginMetaData metaData = pluginMetaData( parser.value( pluginOption ) );
+    if ( !metaData.isValid() ) {
+        std::cerr << "Plugin not found\n";
+        return 1;
+    }
+    const auto result = KPluginFactory::instantiatePlugin<KIO::ThumbnailCreator>( metaData );
+    if ( !result ) {
+        std::cerr << "Cannot load plugin: " << result.errorText.toStdString() << "\n";
+        return 1;
+    }
+    const std::unique_ptr<KIO::ThumbnailCreator> creator{ result.plugin };
+
+    const std::vector<Input> inputs = collectInputs( paths );
+    if ( inputs.empty() ) {
+        std::cerr << "No DDS files found\n";
+        return 1;
+    }
+
+    std::printf( "{\n  \"plugin\": \"%s\",\n  \"files\": %zu,\n  \"runs\": [", metaData.fileName().toUtf8().constData(), inputs.size() );
+    const char* separator = "\n";
+    for ( const bool cold : coldStates ) {
+        for ( const int size : sizes ) {
+            std::vector<double> all{};
+            std::map<std::string, std::vector<double>> perFormat{};
+            std::map<std::string, Memory> perFormatMemory{};
+            Memory memory{};
+            size_t failures = 0;
+            for ( int r = 0; r < repeat; ++r ) {
+                for ( const Input& input : inputs ) {
+                    if ( cold ) dropFromCache( input.path );
+                    else readIntoCache( input.path );
+
+                    const KIO::ThumbnailRequest request{ QUrl::fromLocalFile( input.path ), QSize{ size, size }, input.mimeType, 1.0, 0.0f };
+                    const Clock::time_point begin = Clock::now();
+                    const KIO::ThumbnailResult thumbnail = creator->create( request );
+                    const double ms = std::chrono::duration<double, std::milli>( Clock::now() - begin ).count();
+                    if ( !reports.isOpen() ) reports.open( QIODevice::ReadOnly );
+                    const Memory requestMemory = readReports( reports );
+                    memory.add( requestMemory );
+                    perFormatMemory[ input.format ].add( requestMemory );
+                    if ( !thumbnail.isValid() ) {
+                        failures++;
+                        continue;
+                    }
+                    all.push_back( ms );
+                    perFormat[ input.format ].push_back( ms );
+                }
+            }
+
+            std::printf( "%s    { \"cache\": \"%s\", \"size\": %d, \"requests\": %zu, \"failures\": %zu, "
+                , separator
+                , cold ? "cold" : "warm"
+                , size
+                , all.size() + failures
+                , failures );
+            printLatency( all );
+            printMemory( memory );
+            std::printf( ", \"peakRssKiB\": %ld,\n      \"formats\": [", peakRssKiB() );
+            const char* formatSeparator = "\n";
+            for ( const auto& [ format, samples ] : perFormat ) {
+                std::printf( "%s        { \"format\": \"%s\", \"requests\": %zu, ", formatSeparator, format.c_str(), samples.size() );
+                printLatency( samples );
+                printMemory( perFormatMemory[ format ] );
+                std::printf( " }" );
+                formatSeparator = ",\n";
+            }
+            std::printf( "\n      ] }" );
+            separator = ",\n";
+        }
+    }
+    std::printf( "\n  ]\n}\n" );
+    reports.close();
+    QFile::remove( reportPath );
+    return 0;
+}
@@ -0,0 +1,272 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Calls create() of a single plugin instance from 1 to N threads at once over DDS files, results as JSON on stdout.
+// Every thumbnail is compared against the one made by a lone thread, any difference or failure exits with 1.
+// Time budget is turned off, otherwise slower runs under contention would legitimately degrade.
+
+#include <KIO/ThumbnailCreator>
+#include <KPluginFactory>
+#include <KPluginMetaData>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QImage>
+#include <QUrl>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifndef DDSTHUMBNAIL_PLUGIN_PATH
+#define DDSTHUMBNAIL_PLUGIN_PATH ""
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Input {
+    QString path;
+    QString mimeType;
+    uint64_t reference = 0; // hash of the single thread thumbnail, 0 when it failed
+};
+
+struct Run {
+    unsigned threads = 0;
+    size_t requests = 0;
+    size_t failures = 0;
+    size_t mismatches = 0;
+    double seconds = 0.0;
+};
+
+static QString mimeTypeOf( const QString& path )
+{
+    if ( path.endsWith( QStringLiteral( ".gz" ), Qt::CaseInsensitive ) ) return QStringLiteral( "image/x-gzdds" );
+    if ( path.endsWith( QStringLiteral( ".zst" ), Qt::CaseInsensitive ) ) return QStringLiteral( "image/x-zstddds" );
+    return QStringLiteral( "image/x-dds" );
+}
+
+static std::vector<Input> collectInputs( const QStringList& paths )
+{
+    std::vector<Input> ret{};
+    for ( const QString& path : paths ) {
+        const QFileInfo info{ path };
+        if ( info.isFile() ) {
+            ret.push_back( Input{ info.absoluteFilePath(), mimeTypeOf( path ) } );
+            continue;
+        }
+        QDirIterator it{ path, { QStringLiteral( "*.dds" ), QStringLiteral( "*.dds.gz" ), QStringLiteral( "*.dds.zst" ) }, QDir::Files, QDirIterator::Subdirectories };
+        while ( it.hasNext() ) {
+            const QString file = it.next();
+            ret.push_back( Input{ file, mimeTypeOf( file ) } );
+        }
+    }
+    std::sort( ret.begin(), ret.end(), []( const Input& a, const Input& b ) { return a.path < b.path; } );
+    return ret;
+}
+
+static KPluginMetaData pluginMetaData( const QString& path )
+{
+    if ( !path.isEmpty() ) return KPluginMetaData{ path };
+    return KPluginMetaData::findPluginById( QStringLiteral( "kf6/thumbcreator" ), QStringLiteral( "ddsthumbnail" ) );
+}
+
+// NOTE: FNV-1a of dimensions and visible pixels, padding at the end of scanlines is skipped
+static uint64_t hashImage( const QImage& image )
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash]( const void* data, size_t bytes )
+    {
+        const uint8_t* it = reinterpret_cast<const uint8_t*>( data );
+        for ( size_t i = 0; i < bytes; ++i ) {
+            hash ^= it[ i ];
+            hash *= 0x100000001b3ull;
+        }
+    };
+    const int size[ 2 ]{ image.width(), image.height() };
+    mix( size, sizeof( size ) );
+    const size_t lineBytes = static_cast<size_t>( image.width() ) * 4;
+    for ( int y = 0; y < image.height(); ++y ) {
+        mix( image.constScanLine( y ), lineBytes );
+    }
+    return hash | 1; // never 0
+}
+
+static uint64_t thumbnailHash( KIO::ThumbnailCreator& creator, const Input& input, int size )
+{
+    const KIO::ThumbnailRequest request{ QUrl::fromLocalFile( input.path ), QSize{ size, size }, input.mimeType, 1.0, 0.0f };
+    const KIO::ThumbnailResult result = creator.create( request );
+    if ( !result.isValid() ) return 0;
+    const QImage image = result.image().convertToFormat( QImage::Format_ARGB32 );
+    return hashImage( image );
+}
+
+// NOTE: threads pull requests from a shared counter, each file is requested repeat times per run
+static Run runThreads( KIO::ThumbnailCreator& creator, const std::vector<Input>& inputs, int size, unsigned threads, int repeat )
+{
+    const size_t total = inputs.size() * static_cast<size_t>( repeat );
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> failures{ 0 };
+    std::atomic<size_t> mismatches{ 0 };
+
+    auto work = [&]()
+    {
+        for ( size_t i = next++; i < total; i = next++ ) {
+            const Input& input = inputs[ i % inputs.size() ];
+            const uint64_t hash = thumbnailHash( creator, input, size );
+            if ( !hash ) failures++;
+            else if ( hash != input.reference ) mismatches++;
+        }
+    };
+
+    const Clock::time_point begin = Clock::now();
+    std::vector<std::thread> pool{};
+    for ( unsigned t = 0; t < threads; ++t ) {
+        pool.emplace_back( work );
+    }
+    for ( std::thread& t : pool ) {
+        t.join();
+    }
+
+    Run ret{};
+    ret.threads = threads;
+    ret.requests = total;
+    ret.failures = failures;
+    ret.mismatches = mismatches;
+    ret.seconds = std::chrono::duration<double>( Clock::now() - begin ).count();
+    return ret;
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+    QCoreApplication app{ argc, argv };
+    QCoreApplication::setApplicationName( QStringLiteral( "ddsthumbnail-stress" ) );
+
+    QCommandLineParser parser{};
+    parser.setApplicationDescription( QStringLiteral( "Runs concurrent thumbnail requests through one DDS thumbnail plugin instance" ) );
+    parser.addHelpOption();
+    parser.addPositionalArgument( QStringLiteral( "paths" ), QStringLiteral( "Local files or directories to walk recursively" ), QStringLiteral( "paths..." ) );
+    const QCommandLineOption pluginOption{ { QStringLiteral( "p" ), QStringLiteral( "plugin" ) }
+        , QStringLiteral( "Plugin file to load, defaults to the one built alongside" )
+        , QStringLiteral( "file" )
+        , QStringLiteral( DDSTHUMBNAIL_PLUGIN_PATH ) };
+    const QCommandLineOption threadsOption{ { QStringLiteral( "j" ), QStringLiteral( "threads" ) }
+        , QStringLiteral( "Most threads to run at once, runs double from 1 up to it" )
+        , QStringLiteral( "count" )
+        , QString::number( std::max( std::thread::hardware_concurrency(), 1u ) ) };
+    const QCommandLineOption sizeOption{ { QStringLiteral( "s" ), QStringLiteral( "size" ) }
+        , QStringLiteral( "Target size in pixels" )
+        , QStringLiteral( "pixels" )
+        , QStringLiteral( "256" ) };
+    const QCommandLineOption repeatOption{ { QStringLiteral( "r" ), QStringLiteral( "repeat" ) }
+        , QStringLiteral( "Requests per file in each run" )
+        , QStringLiteral( "count" )
+        , QStringLiteral( "4" ) };
+    parser.addOption( pluginOption );
+    parser.addOption( threadsOption );
+    parser.addOption( sizeOption );
+    parser.addOption( repeatOption );
+    parser.process( app );
+
+    const QStringList paths = parser.positionalArguments();
+    if ( paths.isEmpty() ) {
+        parser.showHelp( 1 );
+    }
+    const unsigned maxThreads = static_cast<unsigned>( std::max( parser.value( threadsOption ).toInt(), 1 ) );
+    const int size = parser.value( sizeOption ).toInt();
+    if ( size <= 0 ) {
+        std::cerr << "Invalid size: " << parser.value( sizeOption ).toStdString() << "\n";
+        return 1;
+    }
+    const int repeat = std::max( parser.value( repeatOption ).toInt(), 1 );
+
+    // NOTE: must be set before the plugin is instantiated, it reads the environment once
+    qputenv( "DDSTHUMBNAIL_TIME_BUDGET_MS", "0" );
+
+    const KPluginMetaData metaData = pluginMetaData( parser.value( pluginOption ) );
+    if ( !metaData.isValid() ) {
+        std::cerr << "Plugin not found\n";
+        return 1;
+    }
+    const auto result = KPluginFactory::instantiatePlugin<KIO::ThumbnailCreator>( metaData );
+    if ( !result ) {
+        std::cerr << "Cannot load plugin: " << result.errorText.toStdString() << "\n";
+        return 1;
+    }
+    const std::unique_ptr<KIO::ThumbnailCreator> creator{ result.plugin };
+
+    std::vector<Input> inputs = collectInputs( paths );
+    if ( inputs.empty() ) {
+        std::cerr << "No DDS files found\n";
+        return 1;
+    }
+    // NOTE: references double as a warm up, files end up in page cache and the pool populated
+    for ( Input& input : inputs ) {
+        input.reference = thumbnailHash( *creator, input, size );
+    }
+
+    std::vector<unsigned> threadCounts{};
+    for ( unsigned n = 1; n < maxThreads; n *= 2 ) {
+        threadCounts.push_back( n );
+    }
+    threadCounts.push_back( maxThreads );
+
+    std::printf( "{\n  \"plugin\": \"%s\",\n  \"files\": %zu,\n  \"size\": %d,\n  \"runs\": [", metaData.fileName().toUtf8().constData(), inputs.size(), size );
+    const char* separator = "\n";
+    double singleRate = 0.0;
+    bool clean = true;
+    for ( const unsigned threads : threadCounts ) {
+        const Run run = runThreads( *creator, inputs, size, threads, repeat );
+        const double rate = run.requests / std::max( run.seconds, 1e-9 );
+        if ( threads == 1 ) singleRate = rate;
+        // NOTE: 1.0 is perfect linear scaling over the single thread run
+        const double efficiency = singleRate > 0.0 ? rate / ( singleRate * threads ) : 0.0;
+        std::printf( "%s    { \"threads\": %u, \"requests\": %zu, \"failures\": %zu, \"mismatches\": %zu, \"seconds\": %.3f, \"requestsPerSecond\": %.1f, \"efficiency\": %.3f }"
+            , separator
+            , run.threads
+            , run.requests
+            , run.failures
+            , run.mismatches
+            , run.seconds
+            , rate
+            , efficiency );
+        separator = ",\n";
+        clean &= !run.mismatches;
+    }
+    std::printf( "\n  ]\n}\n" );
+
+    const size_t referenceFailures = std::count_if( inputs.begin(), inputs.end(), []( const Input& i ) { return !i.reference; } );
+    if ( referenceFailures ) {
+        std::cerr << referenceFailures << " files failed even on a single thread\n";
+    }
+    return clean ? 0 : 1;
+}
@@ -0,0 +1,320 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <QFile>
+#include <QString>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "ddsdecode.hpp"
+
+namespace {
+
+namespace xxh64 {
+
+static constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t P5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotl( uint64_t v, int r )
+{
+    return ( v << r ) | ( v >> ( 64 - r ) );
+}
+
+static inline uint64_t read64( const uint8_t* p )
+{
+    uint64_t v;
+    std::memcpy( &v, p, sizeof( v ) );
+    return v;
+}
+
+static inline uint32_t read32( const uint8_t* p )
+{
+    uint32_t v;
+    std::memcpy( &v, p, sizeof( v ) );
+    return v;
+}
+
+static inline uint64_t accumulate( uint64_t acc, uint64_t input )
+{
+    acc += input * P2;
+    acc = rotl( acc, 31 );
+    return acc * P1;
+}
+
+static inline uint64_t mergeRound( uint64_t acc, uint64_t v )
+{
+    acc ^= accumulate( 0, v );
+    return acc * P1 + P4;
+}
+
+// NOTE: XXH64 as specified by xxHash, little endian only, results match the reference implementation
+static uint64_t hash( const void* data, size_t size, uint64_t seed )
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>( data );
+    const uint8_t* end = p + size;
+    uint64_t h = 0;
+
+    if ( size >= 32 ) {
+        uint64_t v1 = seed + P1 + P2;
+        uint64_t v2 = seed + P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - P1;
+        for ( const uint8_t* limit = end - 32; p <= limit; p += 32 ) {
+            v1 = accumulate( v1, read64( p ) );
+            v2 = accumulate( v2, read64( p + 8 ) );
+            v3 = accumulate( v3, read64( p + 16 ) );
+            v4 = accumulate( v4, read64( p + 24 ) );
+        }
+        h = rotl( v1, 1 ) + rotl( v2, 7 ) + rotl( v3, 12 ) + rotl( v4, 18 );
+        h = mergeRound( h, v1 );
+        h = mergeRound( h, v2 );
+        h = mergeRound( h, v3 );
+        h = mergeRound( h, v4 );
+    }
+    else {
+        h = seed + P5;
+    }
+
+    h += static_cast<uint64_t>( size );
+    for ( ; p + 8 <= end; p += 8 ) {
+        h ^= accumulate( 0, read64( p ) );
+        h = rotl( h, 27 ) * P1 + P4;
+    }
+    if ( p + 4 <= end ) {
+        h ^= static_cast<uint64_t>( read32( p ) ) * P1;
+        h = rotl( h, 23 ) * P2 + P3;
+        p += 4;
+    }
+    for ( ; p < end; ++p ) {
+        h ^= *p * P5;
+        h = rotl( h, 11 ) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+} // namespace xxh64
+
+// NOTE: maps a hash of file content to the pivot cache key of the first path decoded with that content,
+//       so byte identical copies under other paths are served from the same pivot without decoding.
+//       Fixed size table in a shared memory mapped file, read and written by all thumbnailer workers at once
+//       without locking, torn slots are caught by a check word and treated as a miss.
+//       Next to it a bitset of file size and header hashes, content is only hashed once its shape was seen before.
+class DedupIndex {
+public:
+    static constexpr uint32_t SLOT_COUNT = 1u << 15;
+    static constexpr uint32_t PROBE_COUNT = 8;
+    static constexpr uint32_t SHAPE_BITS = 1u << 18;
+    static constexpr qint64 FULL_HASH_BYTES = 64ll << 20;
+    static constexpr qint64 SAMPLE_BYTES = 16ll << 10;
+    static constexpr qint64 SAMPLE_COUNT = 256;
+
+private:
+    struct Header {
+        static constexpr uint32_t MAGIC = 'IDDD';
+        static constexpr uint32_t VERSION = 2; // 2: shape bitset, sampled hash covers header and tail
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t slotCount = 0;
+        uint32_t reserved = 0;
+    };
+    static_assert( sizeof( Header ) == 16 );
+
+    struct Slot {
+        uint64_t content;
+        uint64_t pivot;
+        uint64_t check;
+    };
+    static_assert( sizeof( Slot ) == 24 );
+
+    static constexpr size_t FILE_SIZE = sizeof( Header ) + sizeof( Slot ) * SLOT_COUNT + SHAPE_BITS / 8;
+
+    void* m_data = nullptr;
+
+    Slot* slots() const
+    {
+        return reinterpret_cast<Slot*>( reinterpret_cast<uint8_t*>( m_data ) + sizeof( Header ) );
+    }
+
+    uint64_t* shapeWord( uint64_t shape ) const
+    {
+        uint64_t* words = reinterpret_cast<uint64_t*>( slots() + SLOT_COUNT );
+        return &words[ ( shape % SHAPE_BITS ) / 64 ];
+    }
+
+    static uint64_t check( uint64_t content, uint64_t pivot )
+    {
+        const uint64_t words[ 2 ]{ content, pivot };
+        return xxh64::hash( words, sizeof( words ), Header::MAGIC );
+    }
+
+    // NOTE: fresh file is zero filled by ftruncate, racing workers write the same header into it
+    bool map( const QByteArray& path )
+    {
+        const int fd = ::open( path.constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600 );
+        if ( fd < 0 ) return false;
+        struct stat st{};
+        const bool sized = fstat( fd, &st ) == 0
+            && ( st.st_size == static_cast<off_t>( FILE_SIZE )
+                || ( st.st_size == 0 && ftruncate( fd, FILE_SIZE ) == 0 ) );
+        void* data = sized ? mmap( nullptr, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+        ::close( fd );
+        if ( data == MAP_FAILED ) return false;
+
+        Header* header = reinterpret_cast<Header*>( data );
+        if ( !header->magic ) {
+            *header = Header{ Header::MAGIC, Header::VERSION, SLOT_COUNT, 0 };
+        }
+        if ( header->magic != Header::MAGIC
+            || header->version != Header::VERSION
+            || header->slotCount != SLOT_COUNT ) {
+            munmap( data, FILE_SIZE );
+            return false;
+        }
+        m_data = data;
+        return true;
+    }
+
+public:
+    DedupIndex() = default;
+
+    // NOTE: a file of other size or version is replaced, workers still mapping it keep the old inode
+    explicit DedupIndex( const QString& path )
+    {
+        if ( path.isEmpty() ) return;
+        const QByteArray name = QFile::encodeName( path );
+        if ( map( name ) ) return;
+        ::unlink( name.constData() );
+        map( name );
+    }
+
+    ~DedupIndex()
+    {
+        if ( m_data ) munmap( m_data, FILE_SIZE );
+    }
+
+    DedupIndex( const DedupIndex& ) = delete;
+    DedupIndex& operator = ( const DedupIndex& ) = delete;
+
+    bool enabled() const
+    {
+        return m_data;
+    }
+
+    // NOTE: identical content has identical size and header, far cheaper to compare than to hash the content
+    static uint64_t shapeKey( qint64 size, const void* header, size_t headerSize )
+    {
+        return xxh64::hash( header, headerSize, static_cast<uint64_t>( size ) );
+    }
+
+    // NOTE: whole file when small enough, otherwise its size, header, evenly spaced chunks and the last block,
+    //       large files differing only in between the chunks hash the same. Never 0, 0 marks empty slots
+    static uint64_t contentHash( const QString& path )
+    {
+        QFile file{ path };
+        if ( !file.open( QIODevice::ReadOnly ) ) return 0;
+        const qint64 size = file.size();
+        if ( size <= 0 ) return 0;
+        const uchar* data = file.map( 0, size );
+        if ( !data ) return 0;
+
+        uint64_t ret = 0;
+        if ( size <= FULL_HASH_BYTES ) {
+            ret = xxh64::hash( data, static_cast<size_t>( size ), 0 );
+        }
+        else {
+            ret = xxh64::hash( &size, sizeof( size ), 0 );
+            ret = xxh64::hash( data, dds::MAX_HEADER_BYTES, ret );
+            const qint64 stride = ( size - SAMPLE_BYTES ) / ( SAMPLE_COUNT - 1 );
+            for ( qint64 i = 0; i < SAMPLE_COUNT; ++i ) {
+                ret = xxh64::hash( data + i * stride, SAMPLE_BYTES, ret );
+            }
+            ret = xxh64::hash( data + size - SAMPLE_BYTES, SAMPLE_BYTES, ret );
+        }
+        return ret ? ret : 1;
+    }
+
+    // NOTE: false only when no file of that shape was inserted, content of a seen one may still differ
+    bool seen( uint64_t shape ) const
+    {
+        if ( !m_data ) return false;
+        const uint64_t bit = 1ull << ( shape % 64 );
+        return __atomic_load_n( shapeWord( shape ), __ATOMIC_ACQUIRE ) & bit;
+    }
+
+    uint64_t find( uint64_t content ) const
+    {
+        if ( !m_data || !content ) return 0;
+        Slot* table = slots();
+        for ( uint32_t i = 0; i < PROBE_COUNT; ++i ) {
+            Slot& slot = table[ ( content + i ) & ( SLOT_COUNT - 1 ) ];
+            const uint64_t c = __atomic_load_n( &slot.content, __ATOMIC_ACQUIRE );
+            if ( !c ) return 0;
+            if ( c != content ) continue;
+            const uint64_t pivot = __atomic_load_n( &slot.pivot, __ATOMIC_ACQUIRE );
+            const uint64_t k = __atomic_load_n( &slot.check, __ATOMIC_ACQUIRE );
+            return k == check( c, pivot ) ? pivot : 0;
+        }
+        return 0;
+    }
+
+    // NOTE: takes the slot already holding content or the first empty one, a full probe run evicts a slot picked by hash.
+    //       Shape bits are never cleared, those of evicted slots only cost a hash that misses
+    void insert( uint64_t shape, uint64_t content, uint64_t pivot ) const
+    {
+        if ( !m_data || !content ) return;
+        __atomic_fetch_or( shapeWord( shape ), 1ull << ( shape % 64 ), __ATOMIC_RELEASE );
+        Slot* table = slots();
+        Slot* target = &table[ ( content + ( ( content >> 32 ) % PROBE_COUNT ) ) & ( SLOT_COUNT - 1 ) ];
+        for ( uint32_t i = 0; i < PROBE_COUNT; ++i ) {
+            Slot& slot = table[ ( content + i ) & ( SLOT_COUNT - 1 ) ];
+            const uint64_t c = __atomic_load_n( &slot.content, __ATOMIC_ACQUIRE );
+            if ( !c || c == content ) {
+                target = &slot;
+                break;
+            }
+        }
+        __atomic_store_n( &target->check, 0, __ATOMIC_RELEASE );
+        __atomic_store_n( &target->content, content, __ATOMIC_RELEASE );
+        __atomic_store_n( &target->pivot, pivot, __ATOMIC_RELEASE );
+        __atomic_store_n( &target->check, check( content, pivot ), __ATOMIC_RELEASE );
+    }
+};
+
+} // namespace
@@ -0,0 +1,147 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <KIO/FileJob>
+#include <QEventLoop>
+#include <QIODevice>
+#include <QPointer>
+#include <QTimer>
+#include <QUrl>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// NOTE: random access reads through KIO worker, only byte ranges asked for by the decoder are transferred.
+//       Unbuffered on purpose, so pos() is always where the next readData() starts.
+//       Every request blocks in a nested event loop until the worker replies or TIMEOUT_MS passes.
+class KioRangeDevice : public QIODevice {
+public:
+    static constexpr int TIMEOUT_MS = 30000;
+
+private:
+    QUrl m_url{};
+    QPointer<KIO::FileJob> m_job{};
+    qint64 m_size = 0;
+    qint64 m_jobPos = 0;
+
+    template <typename Signal, typename Fn>
+    bool waitFor( Signal signal, Fn&& onReply )
+    {
+        if ( !m_job ) return false;
+
+        bool replied = false;
+        QEventLoop loop{};
+        QObject::connect( m_job, signal, &loop, std::forward<Fn>( onReply ) );
+        QObject::connect( m_job, signal, &loop, [&replied, &loop]() { replied = true; loop.quit(); } );
+        QObject::connect( m_job, &KJob::result, &loop, &QEventLoop::quit );
+        QTimer::singleShot( TIMEOUT_MS, &loop, &QEventLoop::quit );
+        loop.exec( QEventLoop::ExcludeUserInputEvents );
+
+        if ( !replied && m_job ) {
+            m_job->kill();
+        }
+        return replied;
+    }
+
+public:
+    explicit KioRangeDevice( const QUrl& url )
+    : m_url{ url }
+    {}
+
+    ~KioRangeDevice() override
+    {
+        close();
+    }
+
+    bool open( OpenMode mode ) override
+    {
+        if ( mode & QIODevice::WriteOnly ) return false;
+
+        m_job = KIO::open( m_url, QIODevice::ReadOnly );
+        if ( !waitFor( &KIO::FileJob::open, []( KIO::Job* ) {} ) ) {
+            return false;
+        }
+        m_size = static_cast<qint64>( m_job->size() );
+        m_jobPos = 0;
+        return QIODevice::open( QIODevice::ReadOnly | QIODevice::Unbuffered );
+    }
+
+    void close() override
+    {
+        if ( m_job ) {
+            m_job->close();
+            m_job = nullptr;
+        }
+        QIODevice::close();
+    }
+
+    bool isSequential() const override
+    {
+        return false;
+    }
+
+    qint64 size() const override
+    {
+        return m_size;
+    }
+
+protected:
+    qint64 readData( char* data, qint64 maxSize ) override
+    {
+        if ( !m_job ) return -1;
+
+        if ( m_jobPos != pos() ) {
+            m_job->seek( static_cast<KIO::filesize_t>( pos() ) );
+            auto onPosition = [this]( KIO::Job*, KIO::filesize_t offset ) { m_jobPos = static_cast<qint64>( offset ); };
+            if ( !waitFor( &KIO::FileJob::position, onPosition ) ) return -1;
+        }
+
+        // NOTE: workers reply to a read once and may return less than asked for, empty reply is end of file
+        qint64 total = 0;
+        while ( total < maxSize ) {
+            QByteArray chunk{};
+            m_job->read( static_cast<KIO::filesize_t>( maxSize - total ) );
+            auto onData = [&chunk]( KIO::Job*, const QByteArray& bytes ) { chunk = bytes; };
+            if ( !waitFor( &KIO::FileJob::data, onData ) ) {
+                return total ? total : -1;
+            }
+            if ( chunk.isEmpty() ) break;
+
+            const qint64 bytes = std::min<qint64>( chunk.size(), maxSize - total );
+            std::memcpy( data + total, chunk.constData(), static_cast<size_t>( bytes ) );
+            total += bytes;
+            m_jobPos += chunk.size();
+        }
+        return total;
+    }
+
+    qint64 writeData( const char*, qint64 ) override
+    {
+        return -1;
+    }
+};
+
+} // namespace
@@ -0,0 +1,168 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+namespace {
+
+// NOTE: bytes held by each stage of a single request, charged where the buffer or image is created
+//       and released when it goes away, so peak live bytes follow real lifetimes within create()
+class MemoryAccount {
+public:
+    enum Stage : uint32_t {
+        eReadBand,
+        ePixels,
+        eReduceBand,
+        eCrop,
+        eScale,
+        eStageCount,
+    };
+
+    struct Counters {
+        int64_t bytes = 0; // allocated in total
+        int64_t count = 0;
+        int64_t live = 0;
+        int64_t peak = 0; // of live bytes
+    };
+
+private:
+    Counters m_stages[ eStageCount ]{};
+    int64_t m_live = 0;
+    int64_t m_peak = 0;
+
+public:
+    static const char* name( Stage stage )
+    {
+        switch ( stage ) {
+        case eReadBand: return "readBand";
+        case ePixels: return "pixels";
+        case eReduceBand: return "reduceBand";
+        case eCrop: return "crop";
+        case eScale: return "scale";
+        default: return "none";
+        }
+    }
+
+    void allocate( Stage stage, int64_t bytes )
+    {
+        Counters& c = m_stages[ stage ];
+        c.bytes += bytes;
+        c.count++;
+        c.live += bytes;
+        c.peak = std::max( c.peak, c.live );
+        m_live += bytes;
+        m_peak = std::max( m_peak, m_live );
+    }
+
+    void release( Stage stage, int64_t bytes )
+    {
+        m_stages[ stage ].live -= bytes;
+        m_live -= bytes;
+    }
+
+    const Counters& stage( Stage stage ) const
+    {
+        return m_stages[ stage ];
+    }
+
+    int64_t peak() const
+    {
+        return m_peak;
+    }
+
+    // NOTE: "stages" object without the braces around it, for JSON reports
+    std::string stagesJson() const
+    {
+        std::string ret{};
+        for ( uint32_t i = 0; i < eStageCount; ++i ) {
+            char line[ 160 ];
+            std::snprintf( line, sizeof( line ), "%s\"%s\":{\"bytes\":%lld,\"count\":%lld,\"peakLive\":%lld}"
+                , i ? "," : ""
+                , name( static_cast<Stage>( i ) )
+                , static_cast<long long>( m_stages[ i ].bytes )
+                , static_cast<long long>( m_stages[ i ].count )
+                , static_cast<long long>( m_stages[ i ].peak ) );
+            ret += line;
+        }
+        return ret;
+    }
+};
+
+// NOTE: RAII charge against an account, no-op without one
+class MemoryCharge {
+    MemoryAccount* m_account = nullptr;
+    MemoryAccount::Stage m_stage = MemoryAccount::eStageCount;
+    int64_t m_bytes = 0;
+
+public:
+    MemoryCharge() = default;
+    MemoryCharge( MemoryAccount* account, MemoryAccount::Stage stage, int64_t bytes )
+    : m_account{ account }
+    , m_stage{ stage }
+    , m_bytes{ bytes }
+    {
+        if ( m_account ) m_account->allocate( m_stage, m_bytes );
+    }
+
+    ~MemoryCharge()
+    {
+        if ( m_account ) m_account->release( m_stage, m_bytes );
+    }
+
+    MemoryCharge( const MemoryCharge& ) = delete;
+    MemoryCharge& operator = ( const MemoryCharge& ) = delete;
+
+    MemoryCharge( MemoryCharge&& rhs ) noexcept
+    : m_account{ std::exchange( rhs.m_account, nullptr ) }
+    , m_stage{ rhs.m_stage }
+    , m_bytes{ std::exchange( rhs.m_bytes, 0 ) }
+    {}
+
+    MemoryCharge& operator = ( MemoryCharge&& rhs ) noexcept
+    {
+        std::swap( m_account, rhs.m_account );
+        std::swap( m_stage, rhs.m_stage );
+        std::swap( m_bytes, rhs.m_bytes );
+        return *this;
+    }
+};
+
+// NOTE: one JSON object per line, a single write() each so concurrent workers can share the file
+inline void appendReport( const char* path, const std::string& line )
+{
+    const int fd = ::open( path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600 );
+    if ( fd < 0 ) return;
+    const std::string text = line + "\n";
+    [[maybe_unused]] const ssize_t ret = ::write( fd, text.data(), text.size() );
+    ::close( fd );
+}
+
+} // namespace
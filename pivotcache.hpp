@@ -0,0 +1,195 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QSaveFile>
+#include <QString>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+// NOTE: decoded images stored once at pivot resolution, so requests for other thumbnail sizes
+//       can be served by downscaling a memory mapped file instead of decoding the DDS again
+class PivotCache {
+public:
+    static constexpr int PIVOT_SIZE = 1024;
+
+private:
+    struct Header {
+        enum Flags : uint32_t {
+            fDownscaled = 0x1,
+        };
+        static constexpr uint32_t MAGIC = 'PSDD';
+        static constexpr uint32_t VERSION = 3; // 2: smooth downscale, earlier pivots were nearest neighbour, 3: volumes from top level
+
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        uint64_t key = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t flags = 0;
+        uint32_t reserved = 0;
+    };
+    static_assert( sizeof( Header ) == 32 );
+
+    QString m_dir{};
+    qint64 m_capacity = 0;
+
+    QString pathFor( uint64_t key ) const
+    {
+        return m_dir + QStringLiteral( "/" ) + QString::number( key, 16 ) + QStringLiteral( ".raw" );
+    }
+
+    void evict() const
+    {
+        const QFileInfoList entries = QDir{ m_dir }.entryInfoList( { QStringLiteral( "*.raw" ) }, QDir::Files, QDir::Time | QDir::Reversed );
+        qint64 total = 0;
+        for ( const QFileInfo& entry : entries ) {
+            total += entry.size();
+        }
+        // NOTE: oldest first, loads touch modification time
+        for ( const QFileInfo& entry : entries ) {
+            if ( total <= m_capacity ) break;
+            if ( QFile::remove( entry.absoluteFilePath() ) ) {
+                total -= entry.size();
+            }
+        }
+    }
+
+public:
+    PivotCache() = default;
+    PivotCache( const QString& dir, qint64 capacity )
+    : m_dir{ dir }
+    , m_capacity{ capacity }
+    {
+        if ( m_capacity > 0 && !QDir{}.mkpath( m_dir ) ) {
+            m_capacity = 0;
+        }
+    }
+
+    bool enabled() const
+    {
+        return m_capacity > 0;
+    }
+
+    // NOTE: FNV-1a, must be stable between processes
+    static uint64_t key( const QString& path, qint64 mtime, qint64 size, const void* header, size_t headerSize )
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto mix = [&hash]( const void* data, size_t bytes )
+        {
+            const uint8_t* it = reinterpret_cast<const uint8_t*>( data );
+            for ( size_t i = 0; i < bytes; ++i ) {
+                hash ^= it[ i ];
+                hash *= 0x100000001b3ull;
+            }
+        };
+        const QByteArray utf8 = path.toUtf8();
+        mix( utf8.constData(), static_cast<size_t>( utf8.size() ) );
+        mix( &mtime, sizeof( mtime ) );
+        mix( &size, sizeof( size ) );
+        mix( header, headerSize );
+        return hash;
+    }
+
+    // NOTE: returned image references mapped file, valid to serve target only if not downscaled past it
+    QImage load( uint64_t key, const QSize& target ) const
+    {
+        if ( !enabled() ) return {};
+
+        auto file = std::make_unique<QFile>( pathFor( key ) );
+        if ( !file->open( QIODevice::ReadOnly ) ) return {};
+        if ( file->size() < static_cast<qint64>( sizeof( Header ) ) ) return {};
+
+        uchar* data = file->map( 0, file->size() );
+        if ( !data ) return {};
+
+        Header header{};
+        std::memcpy( &header, data, sizeof( Header ) );
+        const qint64 expectedSize = static_cast<qint64>( sizeof( Header ) ) + (qint64)header.width * (qint64)header.height * 4;
+        if ( header.magic != Header::MAGIC
+            || header.version != Header::VERSION
+            || header.key != key
+            || !header.width
+            || !header.height
+            || file->size() != expectedSize ) {
+            return {};
+        }
+
+        if ( ( header.flags & Header::fDownscaled )
+            && ( target.width() > PIVOT_SIZE || target.height() > PIVOT_SIZE ) ) {
+            return {};
+        }
+
+        file->setFileTime( QDateTime::currentDateTime(), QFileDevice::FileModificationTime );
+        QFile* mapping = file.release();
+        return QImage{ data + sizeof( Header )
+            , static_cast<int>( header.width )
+            , static_cast<int>( header.height )
+            , static_cast<qsizetype>( header.width ) * 4
+            , QImage::Format_ARGB32
+            , []( void* f ) { delete static_cast<QFile*>( f ); }
+            , mapping
+        };
+    }
+
+    void store( uint64_t key, const QImage& image ) const
+    {
+        if ( !enabled() || image.isNull() ) return;
+
+        // NOTE: pivot serves requests of every profile, an aliased one would stay aliased however it is scaled later.
+        //       Smooth scaling hands back premultiplied pixels, stored ones are not
+        const bool downscale = image.width() > PIVOT_SIZE || image.height() > PIVOT_SIZE;
+        const QImage pivot = downscale
+            ? image.scaled( PIVOT_SIZE, PIVOT_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation ).convertToFormat( QImage::Format_ARGB32 )
+            : image;
+        if ( pivot.format() != QImage::Format_ARGB32 ) return;
+
+        Header header{};
+        header.key = key;
+        header.width = static_cast<uint32_t>( pivot.width() );
+        header.height = static_cast<uint32_t>( pivot.height() );
+        header.flags = downscale ? Header::fDownscaled : 0u;
+
+        QSaveFile file{ pathFor( key ) };
+        if ( !file.open( QIODevice::WriteOnly ) ) return;
+        file.write( reinterpret_cast<const char*>( &header ), sizeof( Header ) );
+        const qint64 lineBytes = (qint64)header.width * 4;
+        for ( int y = 0; y < pivot.height(); ++y ) {
+            file.write( reinterpret_cast<const char*>( pivot.constScanLine( y ) ), lineBytes );
+        }
+        if ( file.commit() ) {
+            evict();
+        }
+    }
+};
+
+} // namespace
@@ -0,0 +1,88 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <cstdint>
+#include <iterator>
+
+namespace {
+
+// NOTE: speed and quality trade-off of thumbnails, Profile entry of [General] in ddsthumbnailrc,
+//       read once when a worker loads the plugin
+struct Profile {
+    enum Kind : uint32_t {
+        eFastest,
+        eBalanced,
+        eQuality,
+    };
+
+    static constexpr const char* NAMES[] = { "Fastest", "Balanced", "Quality" };
+
+    Kind kind = eBalanced;
+    uint32_t mipMargin = 2; // smallest mip still covering the target this many times over, 0 keeps the top level
+    uint32_t shrinkMargin = 2; // same for power of two shrink while decoding, 0 decodes at stored size
+    bool sampleBlocks = false; // shrink decodes one block out of each area instead of averaging all of them
+    Qt::TransformationMode filter = Qt::SmoothTransformation;
+    bool linearLight = false;
+    bool readerThread = true;
+
+    static Profile preset( Kind kind )
+    {
+        switch ( kind ) {
+        case eFastest: return Profile{ eFastest, 1, 1, true, Qt::FastTransformation, false, false };
+        case eQuality: return Profile{ eQuality, 0, 0, false, Qt::SmoothTransformation, true, true };
+        default: return Profile{};
+        }
+    }
+
+    static Profile fromName( const QString& name )
+    {
+        for ( uint32_t i = 0; i < std::size( NAMES ); ++i ) {
+            if ( name.compare( QLatin1String( NAMES[ i ] ), Qt::CaseInsensitive ) == 0 ) return preset( static_cast<Kind>( i ) );
+        }
+        return Profile{};
+    }
+
+    // NOTE: DDSTHUMBNAIL_PROFILE takes precedence over the config file, e.g. to compare profiles with ddsthumbnail-latency
+    static Profile load()
+    {
+        const QByteArray env = qgetenv( "DDSTHUMBNAIL_PROFILE" );
+        if ( !env.isEmpty() ) return fromName( QString::fromLatin1( env ) );
+        const KSharedConfig::Ptr config = KSharedConfig::openConfig( QStringLiteral( "ddsthumbnailrc" ), KConfig::SimpleConfig );
+        return fromName( config->group( QStringLiteral( "General" ) ).readEntry( "Profile", QString::fromLatin1( NAMES[ eBalanced ] ) ) );
+    }
+
+    const char* name() const
+    {
+        return NAMES[ kind ];
+    }
+};
+
+} // namespace
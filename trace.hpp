@@ -0,0 +1,187 @@
+// MIT License
+//
+// Copyright (c) 2024 Maciej Latocha <latocha.maciek@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Stage timings written as Chrome trace events, open the file in ui.perfetto.dev or chrome://tracing
+
+#pragma once
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QStandardPaths>
+#include <QString>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+Q_LOGGING_CATEGORY( DDS_TRACE, "kdegraphics.thumbnailer.dds.trace", QtWarningMsg )
+
+// NOTE: enabled by DDSTHUMBNAIL_TRACE=/path/to/trace.json, or by turning on debug output of the
+//       kdegraphics.thumbnailer.dds.trace category which traces into the runtime directory.
+//       Events are appended one write() each so concurrent thumbnailer processes can share the file,
+//       closing bracket is never written, trace viewers accept an unterminated array.
+class Trace {
+    int m_fd = -1;
+
+    Trace()
+    {
+        QString path = qEnvironmentVariable( "DDSTHUMBNAIL_TRACE" );
+        if ( path.isEmpty() && DDS_TRACE().isDebugEnabled() ) {
+            path = QStandardPaths::writableLocation( QStandardPaths::RuntimeLocation ) + QStringLiteral( "/ddsthumbnail-trace.json" );
+        }
+        if ( path.isEmpty() ) return;
+
+        m_fd = ::open( QFile::encodeName( path ).constData(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600 );
+        if ( m_fd < 0 ) return;
+        struct stat st{};
+        if ( ::fstat( m_fd, &st ) == 0 && st.st_size == 0 ) {
+            write( "[\n" );
+        }
+    }
+
+    ~Trace()
+    {
+        if ( m_fd >= 0 ) ::close( m_fd );
+    }
+
+    void write( const std::string& text ) const
+    {
+        [[maybe_unused]] const ssize_t ret = ::write( m_fd, text.data(), text.size() );
+    }
+
+public:
+    Trace( const Trace& ) = delete;
+    Trace& operator = ( const Trace& ) = delete;
+
+    static Trace& instance()
+    {
+        static Trace trace{};
+        return trace;
+    }
+
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    bool enabled() const
+    {
+        return m_fd >= 0;
+    }
+
+    // NOTE: args is a list of "key": value pairs without the braces
+    void complete( const char* name, int64_t begin, int64_t duration, const std::string& args ) const
+    {
+        char prefix[ 256 ];
+        std::snprintf( prefix, sizeof( prefix ), "{\"name\":\"%s\",\"cat\":\"dds\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%ld,\"args\":{"
+            , name
+            , static_cast<long long>( begin )
+            , static_cast<long long>( duration )
+            , static_cast<int>( ::getpid() )
+            , static_cast<long>( ::syscall( SYS_gettid ) ) );
+        write( prefix + args + "}},\n" );
+    }
+};
+
+// NOTE: costs one branch when tracing is off, args are dropped without being formatted
+class TraceScope {
+    const char* m_name = nullptr;
+    int64_t m_begin = 0;
+    std::string m_args{};
+
+    void key( const char* key )
+    {
+        if ( !m_args.empty() ) m_args += ',';
+        m_args += '"';
+        m_args += key;
+        m_args += "\":";
+    }
+
+public:
+    explicit TraceScope( const char* name )
+    {
+        if ( !Trace::instance().enabled() ) return;
+        m_name = name;
+        m_begin = Trace::now();
+    }
+
+    ~TraceScope()
+    {
+        if ( m_name ) Trace::instance().complete( m_name, m_begin, Trace::now() - m_begin, m_args );
+    }
+
+    TraceScope( const TraceScope& ) = delete;
+    TraceScope& operator = ( const TraceScope& ) = delete;
+
+    bool enabled() const
+    {
+        return m_name;
+    }
+
+    void arg( const char* name, int64_t value )
+    {
+        if ( !m_name ) return;
+        key( name );
+        m_args += std::to_string( value );
+    }
+
+    void arg( const char* name, const char* value )
+    {
+        if ( !m_name ) return;
+        key( name );
+        m_args += '"';
+        for ( const char* c = value; *c; ++c ) {
+            if ( *c == '"' || *c == '\\' ) m_args += '\\';
+            if ( static_cast<unsigned char>( *c ) < 0x20 ) continue;
+            m_args += *c;
+        }
+        m_args += '"';
+    }
+
+    void arg( const char* name, const QString& value )
+    {
+        if ( !m_name ) return;
+        arg( name, value.toUtf8().constData() );
+    }
+
+    void arg( const char* name, const int64_t* values, size_t count )
+    {
+        if ( !m_name ) return;
+        key( name );
+        m_args += '[';
+        for ( size_t i = 0; i < count; ++i ) {
+            if ( i ) m_args += ',';
+            m_args += std::to_string( values[ i ] );
+        }
+        m_args += ']';
+    }
+};
+
+} // namespace